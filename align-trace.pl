@@ -0,0 +1,64 @@
+#!/usr/bin/perl
+use Getopt::Std;
+
+##############################################################################
+#
+# This program rewrites a trace file with aligned allocate [m] requests.
+# Every Nth allocate request asks for a payload aligned to ALIGNMENT bytes
+# instead. The other requests are copied as they are.
+#
+##############################################################################
+
+sub usage
+{
+    printf STDERR "$_[0]\n";
+    printf STDERR "Usage: $0 [-h] -f INFILE [-o OUTFILE] [-a ALIGNMENT] [-n N]\n";
+    printf STDERR "Options:\n";
+    printf STDERR "  -h               Print this message\n";
+    printf STDERR "  -f INFILE        Specify input trace file\n";
+    printf STDERR "  -o OUTFILE       Specify output trace file (default: stdout)\n";
+    printf STDERR "  -a ALIGNMENT     Alignment of the aligned requests (default: 64)\n";
+    printf STDERR "  -n N             Align every Nth allocate request (default: 1)\n";
+    die "\n" ;
+}
+
+getopts('hf:o:a:n:');
+
+if ($opt_h) {
+    usage("");
+}
+
+if (!$opt_f) {
+    usage("Missing input file");
+}
+
+my $alignment = $opt_a ? $opt_a : 64;
+my $every = $opt_n ? $opt_n : 1;
+
+if ($alignment & ($alignment - 1)) {
+    usage("Alignment must be a power of two");
+}
+
+open(my $infile, "<", $opt_f) || die "Couldn't open input file '$opt_f'\n";
+
+my $outfile = STDOUT;
+if ($opt_o) {
+    open($outfile, ">", $opt_o) || die "Couldn't open output file '$opt_o'\n";
+}
+
+# the 4-line header is copied as it is
+my $header_lines = 0;
+my $allocs = 0;
+while (my $line = <$infile>) {
+    my @fields = split(' ', $line);
+    next if !@fields;
+    if ($header_lines < 4) {
+        print $outfile "$fields[0]\n";
+        $header_lines++;
+    } elsif ($fields[0] eq "a" && $allocs++ % $every == 0) {
+        print $outfile "m $fields[1] $alignment $fields[2]\n";
+    } else {
+        print $outfile join(" ", @fields) . "\n";
+    }
+}
+close($infile);
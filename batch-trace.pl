@@ -0,0 +1,77 @@
+#!/usr/bin/perl
+use Getopt::Std;
+
+##############################################################################
+#
+# This program rewrites a trace file with batch requests. Runs of
+# consecutive allocate requests of the same size become one batch allocate
+# [A] request, and runs of consecutive free requests one batch free [F]
+# request. The other requests are copied as they are.
+#
+##############################################################################
+
+sub usage
+{
+    printf STDERR "$_[0]\n";
+    printf STDERR "Usage: $0 [-h] -f INFILE [-o OUTFILE]\n";
+    printf STDERR "Options:\n";
+    printf STDERR "  -h               Print this message\n";
+    printf STDERR "  -f INFILE        Specify input trace file\n";
+    printf STDERR "  -o OUTFILE       Specify output trace file (default: stdout)\n";
+    die "\n" ;
+}
+
+getopts('hf:o:');
+
+if ($opt_h) {
+    usage("");
+}
+
+if (!$opt_f) {
+    usage("Missing input file");
+}
+
+open(my $infile, "<", $opt_f) || die "Couldn't open input file '$opt_f'\n";
+
+# header: weight, ids, ops, max data bytes
+my @header;
+while (@header < 4 && defined(my $line = <$infile>)) {
+    push(@header, $line =~ /(\S+)/) if $line =~ /\S/;
+}
+
+my @requests;
+while (my $line = <$infile>) {
+    my @fields = split(' ', $line);
+    push(@requests, \@fields) if @fields;
+}
+close($infile);
+
+# group the runs of requests
+my @lines;
+my $i = 0;
+while ($i < @requests) {
+    my ($type, $id, $size) = @{$requests[$i]};
+    my $j = $i + 1;
+    if ($type eq "a") {
+        $j++ while $j < @requests && $requests[$j][0] eq "a" && $requests[$j][2] == $size;
+    } elsif ($type eq "f" && $id >= 0) {
+        $j++ while $j < @requests && $requests[$j][0] eq "f" && $requests[$j][1] >= 0;
+    }
+
+    my @ids = map { $_->[1] } @requests[$i .. $j - 1];
+    if ($j - $i == 1) {
+        push(@lines, join(" ", @{$requests[$i]}));
+    } elsif ($type eq "a") {
+        push(@lines, "A $size " . scalar(@ids) . " @ids");
+    } else {
+        push(@lines, "F " . scalar(@ids) . " @ids");
+    }
+    $i = $j;
+}
+
+my $outfile = STDOUT;
+if ($opt_o) {
+    open($outfile, ">", $opt_o) || die "Couldn't open output file '$opt_o'\n";
+}
+printf $outfile "%s\n%s\n%d\n%s\n", $header[0], $header[1], scalar(@lines), $header[3];
+print $outfile "$_\n" foreach @lines;
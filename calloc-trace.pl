@@ -0,0 +1,65 @@
+#!/usr/bin/perl
+use Getopt::Std;
+
+##############################################################################
+#
+# This program rewrites a trace file with zeroed allocate [c] requests.
+# Every Nth allocate request asks for an array of ELEMENT byte elements
+# instead, or for a single element if its size is not a multiple of
+# ELEMENT. The other requests are copied as they are.
+#
+##############################################################################
+
+sub usage
+{
+    printf STDERR "$_[0]\n";
+    printf STDERR "Usage: $0 [-h] -f INFILE [-o OUTFILE] [-e ELEMENT] [-n N]\n";
+    printf STDERR "Options:\n";
+    printf STDERR "  -h               Print this message\n";
+    printf STDERR "  -f INFILE        Specify input trace file\n";
+    printf STDERR "  -o OUTFILE       Specify output trace file (default: stdout)\n";
+    printf STDERR "  -e ELEMENT       Element size of the zeroed requests (default: 8)\n";
+    printf STDERR "  -n N             Zero every Nth allocate request (default: 1)\n";
+    die "\n" ;
+}
+
+getopts('hf:o:e:n:');
+
+if ($opt_h) {
+    usage("");
+}
+
+if (!$opt_f) {
+    usage("Missing input file");
+}
+
+my $element = $opt_e ? $opt_e : 8;
+my $every = $opt_n ? $opt_n : 1;
+
+open(my $infile, "<", $opt_f) || die "Couldn't open input file '$opt_f'\n";
+
+my $outfile = STDOUT;
+if ($opt_o) {
+    open($outfile, ">", $opt_o) || die "Couldn't open output file '$opt_o'\n";
+}
+
+# the 4-line header is copied as it is
+my $header_lines = 0;
+my $allocs = 0;
+while (my $line = <$infile>) {
+    my @fields = split(' ', $line);
+    next if !@fields;
+    if ($header_lines < 4) {
+        print $outfile "$fields[0]\n";
+        $header_lines++;
+    } elsif ($fields[0] eq "a" && $fields[2] > 0 && $allocs++ % $every == 0) {
+        if ($fields[2] % $element == 0) {
+            print $outfile "c $fields[1] " . ($fields[2] / $element) . " $element\n";
+        } else {
+            print $outfile "c $fields[1] 1 $fields[2]\n";
+        }
+    } else {
+        print $outfile join(" ", @fields) . "\n";
+    }
+}
+close($infile);
@@ -0,0 +1,77 @@
+#!/usr/bin/perl
+use Getopt::Std;
+
+##############################################################################
+#
+# This program generates a trace of growing buffers. Each round reallocates
+# every buffer GROWTH percent larger, up to MAX bytes, and allocates a small
+# block after each one, so a heap buffer cannot grow in place and has to
+# move every round. With -a, the buffers start as blocks aligned to ALIGN
+# bytes. All blocks are freed at the end.
+#
+##############################################################################
+
+sub usage
+{
+    printf STDERR "$_[0]\n";
+    printf STDERR "Usage: $0 [-h] [-o OUTFILE] [-n N] [-s START] [-m MAX] [-g GROWTH] [-a ALIGN]\n";
+    printf STDERR "Options:\n";
+    printf STDERR "  -h               Print this message\n";
+    printf STDERR "  -o OUTFILE       Specify output trace file (default: stdout)\n";
+    printf STDERR "  -n N             Number of buffers (default: 64)\n";
+    printf STDERR "  -s START         Initial size of a buffer (default: 4096)\n";
+    printf STDERR "  -m MAX           Final size of a buffer (default: 1048576)\n";
+    printf STDERR "  -g GROWTH        Growth of a buffer in percent per round (default: 25)\n";
+    printf STDERR "  -a ALIGN         Alignment of the initial buffers (default: none)\n";
+    die "\n" ;
+}
+
+getopts('ho:n:s:m:g:a:');
+
+if ($opt_h) {
+    usage("");
+}
+
+my $buffers = $opt_n ? $opt_n : 64;
+my $start = $opt_s ? $opt_s : 4096;
+my $max = $opt_m ? $opt_m : 1048576;
+my $growth = $opt_g ? $opt_g : 25;
+my $spacer = 64;
+
+if ($start > $max || $growth <= 0) {
+    usage("Invalid sizes");
+}
+
+my $outfile = STDOUT;
+if ($opt_o) {
+    open($outfile, ">", $opt_o) || die "Couldn't open output file '$opt_o'\n";
+}
+
+# buffers are ids 0 to N-1, the small blocks follow
+my @ops;
+my @sizes = ($start) x $buffers;
+my $ids = $buffers;
+my $live = $start * $buffers;
+my $max_live = $live;
+for (my $i = 0; $i < $buffers; $i++) {
+    push(@ops, $opt_a ? "m $i $opt_a $start" : "a $i $start");
+}
+while ($sizes[0] < $max) {
+    for (my $i = 0; $i < $buffers; $i++) {
+        my $size = int($sizes[$i] * (100 + $growth) / 100);
+        $size = $max if $size > $max;
+        $size = $sizes[$i] + 1 if $size <= $sizes[$i];
+        push(@ops, "r $i $size");
+        push(@ops, "a $ids $spacer");
+        $live += $size - $sizes[$i] + $spacer;
+        $sizes[$i] = $size;
+        $ids++;
+    }
+    $max_live = $live if $live > $max_live;
+}
+for (my $i = 0; $i < $ids; $i++) {
+    push(@ops, "f $i");
+}
+
+print $outfile "1\n$ids\n" . scalar(@ops) . "\n$max_live\n";
+print $outfile join("\n", @ops) . "\n";
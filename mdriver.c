@@ -20,6 +20,9 @@
 #include <unistd.h>
 #include <stdbool.h>
 #include <math.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
 
 #include "mm.h"
 #include "memlib.h"
@@ -35,6 +38,11 @@
 #define MAXLINE     1024          /* max string size */
 #define HDRLINES       4          /* number of header lines in a trace file */
 #define LINENUM(i) (i+HDRLINES+1) /* cnvt trace request nums to linenums (origin 1) */
+#define RESIDENT_SAMPLES 16       /* resident heap samples per trace (-r) */
+#define WALK_STEPS (1 << 22)      /* random accesses of the walk over the live blocks (-H) */
+#define STREAM_LINES (1 << 24)    /* cache lines read by the streaming benchmark (-C) */
+#define FIT_RUNS 5                /* runs of each trace whose fewest cycles per malloc count (-S) */
+#define CACHE_LINE 64
 
 #ifndef REF_ONLY
 #define REF_ONLY 0
@@ -80,9 +88,13 @@ typedef struct {
 
 /* Characterizes a single trace operation (allocator request) */
 typedef struct {
-    enum { ALLOC, FREE, REALLOC } type; /* type of request */
+    enum { ALLOC, FREE, REALLOC, ALLOC_BATCH, FREE_BATCH, ALLOC_ALIGNED, ALLOC_ZEROED } type; /* type of request */
     long index;                         /* index for free() to use later */
     size_t size;                        /* byte size of alloc/realloc request */
+    size_t alignment;                   /* payload alignment of an aligned alloc request */
+    size_t nmemb;                       /* number of elements of a zeroed alloc request */
+    int count;                          /* number of blocks of a batch request */
+    int *indices;                       /* indices of the blocks of a batch request */
 } traceop_t;
 
 /* Holds the information for one trace file */
@@ -91,9 +103,12 @@ typedef struct {
     size_t data_bytes;    /* Peak number of data bytes allocated during trace */
     int num_ids;          /* number of alloc/realloc ids */
     int num_ops;          /* number of distinct requests */
+    int num_requests;     /* number of blocks requested, counting each block of a batch */
+    int max_count;        /* largest batch request */
     weight_t weight;      /* weight for this trace */
     traceop_t *ops;       /* array of requests */
     char **blocks;        /* array of ptrs returned by malloc/realloc... */
+    char **batch_blocks;  /* scratch array of ptrs passed to the batch functions */
     size_t *block_sizes;  /* ... and a corresponding array of payload sizes */
     int *block_rand_base; /* index into random_data, if debug is on */
 } trace_t;
@@ -120,6 +135,17 @@ typedef struct {
 
     /* defined only for the student malloc package */
     double util;       /* space utilization for this trace (always 0 for libc) */
+    size_t peak_heap;  /* peak heap size, the high water mark of brk plus mappings */
+    size_t resident[RESIDENT_SAMPLES]; /* resident heap bytes over the trace (-r) */
+    size_t peak_resident; /* peak of the resident heap bytes sampled (-r) */
+    int peak_op;       /* request after which the most payload bytes are live */
+    double tlb_misses[2]; /* dTLB load misses per 1000 walk accesses, huge pages off and on (-H), -1 if unknown */
+    double walk_ns[2];    /* ns per walk access, huge pages off and on (-H) */
+    size_t huge_bytes[2]; /* heap bytes backed by huge pages during the walk, huge pages off and on (-H) */
+    double fit_nodes;     /* free list nodes visited by the fit scans per malloc (-S), -1 if unknown */
+    double malloc_cycles; /* time stamp counter cycles per malloc (-S), -1 if unknown */
+    double free_accesses; /* metadata accesses per free fed to the modeled cache (-M), -1 if unknown */
+    double free_misses;   /* of those, misses per free (-M), -1 if unknown */
 
     /* Note: secs and util are only defined if valid is true */
 } stats_t;
@@ -159,6 +185,14 @@ int verbose = REF_ONLY ? 0 : 1;  /* global flag for verbose output */
 static int errors = 0;           /* number of errs found when running student malloc */
 static bool onetime_flag = false;
 static bool tab_mode = false;     /* Print output as tab-separated fields */
+static bool sized_free = false;   /* Free with mm_free_sized (set by -z) */
+static bool expand_first = false; /* Grow with mm_try_expand before mm_realloc (set by -x) */
+static bool resident_mode = false; /* Report resident heap bytes over time (set by -r) */
+static bool tlb_mode = false;     /* Report dTLB misses with huge pages off and on (set by -H) */
+static int stream_blocks = 0;     /* Blocks streamed through at once with coloring off and on (set by -C) */
+static bool fresh_heap = false;   /* Give the heap back before each timed run (set by -Z) */
+static bool fit_mode = false;     /* Report fit scan nodes and cycles per malloc (set by -S) */
+static bool cache_mode = false;   /* Report modeled metadata cache misses per free (set by -M) */
 static size_t maxfill = MAXFILL;
 
 /* by default, no timeouts */
@@ -201,6 +235,9 @@ static void free_range_set(range_set_t *ranges);
 /* These functions implement the debugging code */
 static void init_random_data(void);
 static bool check_index(const trace_t *trace, int opnum, int index, int realloc);
+static size_t check_usable_size(const trace_t *trace, int opnum, char *p,
+                                size_t size, bool fresh);
+static char *mm_resize(char *oldp, size_t oldsize, size_t newsize);
 static void randomize_block(trace_t *trace, int index);
 
 /* These functions read, allocate, and free storage for traces */
@@ -216,11 +253,20 @@ static void eval_libc_speed(void *ptr);
 /* Routines for evaluating correctnes, space utilization, and speed
    of the student's malloc package in mm.c */
 static bool eval_mm_valid(trace_t *trace, range_set_t *ranges);
-static double eval_mm_util(trace_t *trace, int tracenum);
+static double eval_mm_util(trace_t *trace, int tracenum, stats_t *stats);
 static void eval_mm_speed(void *ptr);
+static void replay_op(trace_t *trace, int i);
+static void eval_mm_tlb(trace_t *trace, int tracenum, stats_t *stats);
+static void eval_mm_fit(trace_t *trace, int tracenum, stats_t *stats);
+static void eval_mm_cache(trace_t *trace, int tracenum, stats_t *stats);
+static void eval_mm_coloring(int n);
 
 /* Various helper routines */
 static void printresults(int n, stats_t *stats, sum_stats_t *sumstats);
+static void printresident(int n, stats_t *stats);
+static void printtlb(int n, stats_t *stats);
+static void printfit(int n, stats_t *stats);
+static void printcache(int n, stats_t *stats);
 static void usage(char *prog);
 static void malloc_error(const trace_t *trace, int opnum, const char *fmt, ...)
     __attribute__((format(printf, 3,4)));
@@ -262,7 +308,7 @@ static void run_tests(int num_tracefiles, const char *tracedir,
         trace_t *trace;
         trace = read_trace(&mm_stats[i], tracedir, tracefiles[i]);
         strcpy(mm_stats[i].filename, trace->filename);
-        mm_stats[i].ops = trace->num_ops;
+        mm_stats[i].ops = trace->num_requests;
 
         /* Prepare for timeout */
         if (setjmp(timeout_jmpbuf) != 0) {
@@ -282,7 +328,13 @@ static void run_tests(int num_tracefiles, const char *tracedir,
         if (mm_stats[i].valid) {
             if (verbose > 1)
                 printf("efficiency, ");
-            mm_stats[i].util = eval_mm_util(trace, i);
+            mm_stats[i].util = eval_mm_util(trace, i, &mm_stats[i]);
+            if (tlb_mode)
+                eval_mm_tlb(trace, i, &mm_stats[i]);
+            if (fit_mode)
+                eval_mm_fit(trace, i, &mm_stats[i]);
+            if (cache_mode)
+                eval_mm_cache(trace, i, &mm_stats[i]);
             speed_params->trace = trace;
             if (verbose > 1)
                 printf("and performance.\n");
@@ -356,7 +408,7 @@ int main(int argc, char **argv)
     /*
      * Read and interpret the command line arguments
      */
-    while ((c = getopt(argc, argv, "d:f:c:s:t:v:hOVlDT")) != EOF) {
+    while ((c = getopt(argc, argv, "d:f:c:s:t:v:hOVlDTzxrHSMZC:")) != EOF) {
         switch (c) {
 
             case 'f': /* Use one specific trace file only (relative to curr dir) */
@@ -406,6 +458,38 @@ int main(int argc, char **argv)
                 tab_mode = true;
                 break;
 
+            case 'z': /* Free with mm_free_sized */
+                sized_free = true;
+                break;
+
+            case 'x': /* Grow with mm_try_expand before mm_realloc */
+                expand_first = true;
+                break;
+
+            case 'r': /* Report resident heap bytes over time */
+                resident_mode = true;
+                break;
+
+            case 'H': /* Report dTLB misses with huge pages off and on */
+                tlb_mode = true;
+                break;
+
+            case 'S': /* Report fit scan nodes and cycles per malloc */
+                fit_mode = true;
+                break;
+
+            case 'M': /* Report modeled metadata cache misses per free */
+                cache_mode = true;
+                break;
+
+            case 'Z': /* Time every run on zero pages */
+                fresh_heap = true;
+                break;
+
+            case 'C': /* Stream through blocks with coloring off and on */
+                stream_blocks = atoi(optarg);
+                break;
+
             case 'h': /* Print this message */
                 usage(argv[0]);
                 exit(0);
@@ -518,6 +602,26 @@ int main(int argc, char **argv)
             printf("\nResults for mm malloc:\n");
             printresults(num_global_tracefiles, mm_stats, &global_mm_sum_stats);
             printf("\n");
+            if (resident_mode) {
+                printresident(num_global_tracefiles, mm_stats);
+                printf("\n");
+            }
+            if (tlb_mode) {
+                printtlb(num_global_tracefiles, mm_stats);
+                printf("\n");
+            }
+            if (fit_mode) {
+                printfit(num_global_tracefiles, mm_stats);
+                printf("\n");
+            }
+            if (cache_mode) {
+                printcache(num_global_tracefiles, mm_stats);
+                printf("\n");
+            }
+            if (stream_blocks > 0) {
+                eval_mm_coloring(stream_blocks);
+                printf("\n");
+            }
         }
     }
 
@@ -712,11 +816,12 @@ static bool add_range(range_set_t *ranges, char *lo, size_t size,
         return false;
     }
 
-    /* The payload must lie within the extent of the heap */
-    if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) ||
-        (hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) {
+    /* The payload must lie within the extent of the heap, or of a mapping */
+    if (((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) ||
+         (hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) &&
+        !mem_in_mapping(lo, hi)) {
         malloc_error(trace, opnum,
-                     "Payload (%p:%p) lies outside heap (%p:%p)",
+                     "Payload (%p:%p) lies outside heap (%p:%p) and mappings",
                      lo, hi, mem_heap_lo(), mem_heap_hi());
         return false;
     }
@@ -919,6 +1024,39 @@ static bool check_index(const trace_t *trace, int opnum, int index, int realloc)
     return true;
 }
 
+/*
+ * check_usable_size - returns the usable size of block p of size bytes, or 0
+ *     if it is below size or, for a block fresh from mm_malloc, above the
+ *     size mm_good_size promised
+ */
+static size_t check_usable_size(const trace_t *trace, int opnum, char *p,
+                                size_t size, bool fresh) {
+    size_t usable = mm_malloc_usable_size(p);
+
+    if (usable < size) {
+        malloc_error(trace, opnum, "mm_malloc_usable_size (%zu) below the "
+                     "requested size (%zu)", usable, size);
+        return 0;
+    }
+    if (fresh && usable > mm_good_size(size)) {
+        malloc_error(trace, opnum, "mm_malloc_usable_size (%zu) above "
+                     "mm_good_size (%zu)", usable, mm_good_size(size));
+        return 0;
+    }
+    return usable;
+}
+
+/*
+ * mm_resize - resizes a block with mm_realloc or, with -x, first tries to
+ *     grow it in place with mm_try_expand, as a container would
+ */
+static char *mm_resize(char *oldp, size_t oldsize, size_t newsize) {
+    if (expand_first && oldp != NULL && newsize > oldsize &&
+        mm_try_expand(oldp, newsize, newsize) >= newsize)
+        return oldp;
+    return mm_realloc(oldp, newsize);
+}
+
 /**********************************************
  * The following routines manipulate tracefiles
  *********************************************/
@@ -934,8 +1072,12 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
     char type[MAXLINE];
     int index;
     size_t size;
+    size_t alignment;
+    size_t nmemb;
     int max_index = 0;
     int op_index;
+    int count;
+    int i;
     int ignore = 0;
 
     if (verbose > 1)
@@ -986,7 +1128,11 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
     /* read every request line in the trace file */
     index = 0;
     op_index = 0;
+    trace->num_requests = 0;
+    trace->max_count = 1;
     while (fscanf(tracefile, "%s", type) != EOF) {
+        trace->ops[op_index].count = 1;
+        trace->ops[op_index].indices = NULL;
         switch(type[0]) {
             case 'a':
                 ignore += fscanf(tracefile, "%u %lu", &index, &size);
@@ -995,6 +1141,30 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
                 trace->ops[op_index].size = size;
                 max_index = (index > max_index) ? index : max_index;
                 break;
+            case 'm':
+                ignore += fscanf(tracefile, "%u %lu %lu", &index, &alignment, &size);
+                if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+                    app_error("Alignment %lu is not a power of two in tracefile %s\n",
+                              alignment, trace->filename);
+                }
+                trace->ops[op_index].type = ALLOC_ALIGNED;
+                trace->ops[op_index].index = index;
+                trace->ops[op_index].size = size;
+                trace->ops[op_index].alignment = alignment;
+                max_index = (index > max_index) ? index : max_index;
+                break;
+            case 'c':
+                ignore += fscanf(tracefile, "%u %lu %lu", &index, &nmemb, &size);
+                if (nmemb == 0) {
+                    app_error("Zeroed alloc of no elements in tracefile %s\n",
+                              trace->filename);
+                }
+                trace->ops[op_index].type = ALLOC_ZEROED;
+                trace->ops[op_index].index = index;
+                trace->ops[op_index].size = nmemb * size;
+                trace->ops[op_index].nmemb = nmemb;
+                max_index = (index > max_index) ? index : max_index;
+                break;
             case 'r':
                 ignore += fscanf(tracefile, "%u %lu", &index, &size);
                 trace->ops[op_index].type = REALLOC;
@@ -1007,21 +1177,54 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
                 trace->ops[op_index].type = FREE;
                 trace->ops[op_index].index = index;
                 break;
+            case 'A':
+            case 'F':
+                if (type[0] == 'A') {
+                    ignore += fscanf(tracefile, "%lu %d", &size, &count);
+                    trace->ops[op_index].type = ALLOC_BATCH;
+                    trace->ops[op_index].size = size;
+                } else {
+                    ignore += fscanf(tracefile, "%d", &count);
+                    trace->ops[op_index].type = FREE_BATCH;
+                }
+                if (count < 1) {
+                    app_error("Empty batch request in tracefile %s\n",
+                              trace->filename);
+                }
+                if ((trace->ops[op_index].indices =
+                     (int *)malloc(count * sizeof(int))) == NULL)
+                    unix_error("malloc 6 failed in read_trace");
+                for (i = 0; i < count; i++) {
+                    ignore += fscanf(tracefile, "%u", &index);
+                    trace->ops[op_index].indices[i] = index;
+                    max_index = (index > max_index) ? index : max_index;
+                }
+                trace->ops[op_index].index = trace->ops[op_index].indices[0];
+                trace->ops[op_index].count = count;
+                trace->max_count = (count > trace->max_count) ?
+                    count : trace->max_count;
+                break;
             default:
                 app_error("Bogus type character (%c) in tracefile %s\n",
                           type[0], trace->filename);
         }
+        trace->num_requests += trace->ops[op_index].count;
         op_index++;
         if (op_index == trace->num_ops) break;
     }
     fclose(tracefile);
+
+    /* scratch array for the batch requests */
+    if ((trace->batch_blocks =
+         (char **)malloc(trace->max_count * sizeof(char *))) == NULL)
+        unix_error("malloc 7 failed in read_trace");
     assert(max_index == trace->num_ids - 1);
     assert(trace->num_ops == op_index);
 
     /* fill in the stats */
     strcpy(stats->filename, trace->filename);
     stats->weight = trace->weight;
-    stats->ops = trace->num_ops;
+    stats->ops = trace->num_requests;
 
     return trace;
 }
@@ -1042,8 +1245,14 @@ static void reinit_trace(trace_t *trace)
  */
 static void free_trace(trace_t *trace)
 {
+    int i;
+
+    for (i = 0; i < trace->num_ops; i++) {
+        free(trace->ops[i].indices); /* the indices of the batch requests... */
+    }
     free(trace->ops);         /* free the three arrays... */
     free(trace->blocks);
+    free(trace->batch_blocks);
     free(trace->block_sizes);
     free(trace->block_rand_base);
     free(trace);              /* and the trace record itself... */
@@ -1059,9 +1268,11 @@ static void free_trace(trace_t *trace)
  */
 static bool eval_mm_valid(trace_t *trace, range_set_t *ranges)
 {
-    int i;
+    int i, j;
     int index;
     size_t size;
+    size_t usable;
+    size_t offset;
     char *newp;
     char *oldp;
     char *p;
@@ -1113,9 +1324,12 @@ static bool eval_mm_valid(trace_t *trace, range_set_t *ranges)
                 /*
                  * Test the range of the new block for correctness and add it
                  * to the range list if OK. The block must be  be aligned properly,
-                 * and must not overlap any currently allocated block.
+                 * and must not overlap any currently allocated block, up to
+                 * its usable size.
                  */
-                if (add_range(ranges, p, size, trace, i, index) == 0)
+                if ((usable = check_usable_size(trace, i, p, size, true)) == 0)
+                    return false;
+                if (add_range(ranges, p, usable, trace, i, index) == 0)
                     return false;
 
                 /* Remember region */
@@ -1126,13 +1340,65 @@ static bool eval_mm_valid(trace_t *trace, range_set_t *ranges)
                 randomize_block(trace, index);
                 break;
 
+            case ALLOC_ALIGNED: /* mm_memalign */
+
+                /* Call the student's memalign */
+                if ((p = mm_memalign(trace->ops[i].alignment, size)) == NULL) {
+                    malloc_error(trace, i, "mm_memalign failed.");
+                    return false;
+                }
+
+                /* The payload must have the requested alignment */
+                if (((unsigned long)p) % trace->ops[i].alignment != 0) {
+                    malloc_error(trace, i, "Payload address (%p) not aligned to %zu bytes",
+                                 p, trace->ops[i].alignment);
+                    return false;
+                }
+
+                /* Check, remember and randomize the block as for mm_malloc */
+                if ((usable = check_usable_size(trace, i, p, size, false)) == 0)
+                    return false;
+                if (add_range(ranges, p, usable, trace, i, index) == 0)
+                    return false;
+                trace->blocks[index] = p;
+                trace->block_sizes[index] = size;
+                randomize_block(trace, index);
+                break;
+
+            case ALLOC_ZEROED: /* mm_calloc */
+
+                /* Call the student's calloc */
+                if ((p = mm_calloc(trace->ops[i].nmemb, size / trace->ops[i].nmemb)) == NULL) {
+                    malloc_error(trace, i, "mm_calloc failed.");
+                    return false;
+                }
+
+                /* The payload must read zero */
+                for (offset = 0; offset < size; offset++) {
+                    if (p[offset] != 0) {
+                        malloc_error(trace, i, "Payload byte %zu of calloc block (%p) is not zero",
+                                     offset, p);
+                        return false;
+                    }
+                }
+
+                /* Check, remember and randomize the block as for mm_malloc */
+                if ((usable = check_usable_size(trace, i, p, size, true)) == 0)
+                    return false;
+                if (add_range(ranges, p, usable, trace, i, index) == 0)
+                    return false;
+                trace->blocks[index] = p;
+                trace->block_sizes[index] = size;
+                randomize_block(trace, index);
+                break;
+
             case REALLOC: /* mm_realloc */
                 if (!check_index(trace, i, index, 0))
                     return false;
 
                 /* Call the student's realloc */
                 oldp = trace->blocks[index];
-                newp = mm_realloc(oldp, size);
+                newp = mm_resize(oldp, trace->block_sizes[index], size);
                 if ( (newp == NULL) && (size != 0) ) {
                     malloc_error(trace, i, "mm_realloc failed.");
                     return false;
@@ -1148,7 +1414,9 @@ static bool eval_mm_valid(trace_t *trace, range_set_t *ranges)
 
                 /* Check new block for correctness and add it to range list */
                 if (size > 0) {
-                    if (add_range(ranges, newp, size, trace, i, index) == 0)
+                    if ((usable = check_usable_size(trace, i, newp, size, false)) == 0)
+                        return false;
+                    if (add_range(ranges, newp, usable, trace, i, index) == 0)
                         return false;
                 }
 
@@ -1176,11 +1444,54 @@ static bool eval_mm_valid(trace_t *trace, range_set_t *ranges)
                 /* Remove region from list and call student's free function */
                 if (index == -1) {
                     p = 0;
+                    size = 0;
                 } else {
                     p = trace->blocks[index];
+                    size = trace->block_sizes[index];
+                    remove_range(ranges, p);
+                }
+                if (sized_free)
+                    mm_free_sized(p, size);
+                else
+                    mm_free(p);
+                break;
+
+            case ALLOC_BATCH: /* mm_malloc_batch */
+
+                /* Call the student's batch malloc */
+                if (mm_malloc_batch(size, trace->ops[i].count,
+                                    (void **)trace->batch_blocks)
+                    != (size_t)trace->ops[i].count) {
+                    malloc_error(trace, i, "mm_malloc_batch failed.");
+                    return false;
+                }
+
+                /* Check, remember and randomize each block as for mm_malloc */
+                for (j = 0; j < trace->ops[i].count; j++) {
+                    index = trace->ops[i].indices[j];
+                    p = trace->batch_blocks[j];
+                    if ((usable = check_usable_size(trace, i, p, size, true)) == 0)
+                        return false;
+                    if (add_range(ranges, p, usable, trace, i, index) == 0)
+                        return false;
+                    trace->blocks[index] = p;
+                    trace->block_sizes[index] = size;
+                    randomize_block(trace, index);
+                }
+                break;
+
+            case FREE_BATCH: /* mm_free_batch */
+
+                /* Remove each region from the list and call student's batch free */
+                for (j = 0; j < trace->ops[i].count; j++) {
+                    index = trace->ops[i].indices[j];
+                    if (!check_index(trace, i, index, 0))
+                        return false;
+                    p = trace->blocks[index];
                     remove_range(ranges, p);
+                    trace->batch_blocks[j] = p;
                 }
-                mm_free(p);
+                mm_free_batch((void **)trace->batch_blocks, trace->ops[i].count);
                 break;
 
             default:
@@ -1197,26 +1508,36 @@ static bool eval_mm_valid(trace_t *trace, range_set_t *ranges)
  *   an optimal allocator, i.e., no gaps and no internal fragmentation.
  *   Utilization is the ratio hwm/heapsize, where heapsize is the
  *   size of the heap in bytes after running the student's malloc
- *   package on the trace. Note that our implementation of mem_sbrk()
- *   doesn't allow the students to decrement the brk pointer, so brk
- *   is always the high water mark of the heap.
+ *   package on the trace. Since mem_sbrk() can decrement the brk
+ *   pointer, heapsize is the high water mark over the trace of brk
+ *   plus the size of the mappings made by mm_map.
+ *
+ *   With -r, the bytes of the heap held in physical memory, which purged
+ *   pages and a trimmed heap give back, are also sampled RESIDENT_SAMPLES
+ *   times over the trace into stats.
  *
  *   A higher number is better: 1 is optimal.
  */
-static double eval_mm_util(trace_t *trace, int tracenum)
+static double eval_mm_util(trace_t *trace, int tracenum, stats_t *stats)
 {
-    int i;
+    int i, j;
     int index;
     size_t size, newsize, oldsize;
     size_t max_total_size = 0;
     size_t total_size = 0;
     size_t max_heap_size = 0;
     size_t heap_size = 0;
+    size_t resident_size, max_resident_size = 0;
+    int sample = 0;
     char *p;
     char *newp, *oldp;
 
     reinit_trace(trace);
 
+    /* the pages of the previous runs would count as resident */
+    if (resident_mode)
+        mm_purge(mem_heap_lo(), mem_heapsize());
+
     /* initialize the heap and the mm malloc package */
     mem_reset_brk();
     if (!mm_init())
@@ -1241,13 +1562,45 @@ static double eval_mm_util(trace_t *trace, int tracenum)
                 total_size += size;
                 break;
 
+            case ALLOC_ALIGNED: /* mm_memalign */
+                index = trace->ops[i].index;
+                size = trace->ops[i].size;
+
+                if ((p = mm_memalign(trace->ops[i].alignment, size)) == NULL) {
+                    app_error("trace %d: mm_memalign failed in eval_mm_util",
+                              tracenum);
+                }
+
+                /* Remember region and size */
+                trace->blocks[index] = p;
+                trace->block_sizes[index] = size;
+
+                total_size += size;
+                break;
+
+            case ALLOC_ZEROED: /* mm_calloc */
+                index = trace->ops[i].index;
+                size = trace->ops[i].size;
+
+                if ((p = mm_calloc(trace->ops[i].nmemb, size / trace->ops[i].nmemb)) == NULL) {
+                    app_error("trace %d: mm_calloc failed in eval_mm_util",
+                              tracenum);
+                }
+
+                /* Remember region and size */
+                trace->blocks[index] = p;
+                trace->block_sizes[index] = size;
+
+                total_size += size;
+                break;
+
             case REALLOC: /* mm_realloc */
                 index = trace->ops[i].index;
                 newsize = trace->ops[i].size;
                 oldsize = trace->block_sizes[index];
 
                 oldp = trace->blocks[index];
-                if ((newp = mm_realloc(oldp,newsize)) == NULL && newsize != 0) {
+                if ((newp = mm_resize(oldp, oldsize, newsize)) == NULL && newsize != 0) {
                     app_error("trace %d: mm_realloc failed in eval_mm_util",
                               tracenum);
                 }
@@ -1269,28 +1622,76 @@ static double eval_mm_util(trace_t *trace, int tracenum)
                     p = trace->blocks[index];
                 }
 
-                mm_free(p);
+                if (sized_free)
+                    mm_free_sized(p, size);
+                else
+                    mm_free(p);
 
                 total_size -= size;
                 break;
 
+            case ALLOC_BATCH: /* mm_malloc_batch */
+                size = trace->ops[i].size;
+
+                if (mm_malloc_batch(size, trace->ops[i].count,
+                                    (void **)trace->batch_blocks)
+                    != (size_t)trace->ops[i].count) {
+                    app_error("trace %d: mm_malloc_batch failed in eval_mm_util",
+                              tracenum);
+                }
+
+                /* Remember regions and sizes */
+                for (j = 0; j < trace->ops[i].count; j++) {
+                    index = trace->ops[i].indices[j];
+                    trace->blocks[index] = trace->batch_blocks[j];
+                    trace->block_sizes[index] = size;
+                }
+
+                total_size += size * trace->ops[i].count;
+                break;
+
+            case FREE_BATCH: /* mm_free_batch */
+                for (j = 0; j < trace->ops[i].count; j++) {
+                    index = trace->ops[i].indices[j];
+                    trace->batch_blocks[j] = trace->blocks[index];
+                    total_size -= trace->block_sizes[index];
+                }
+
+                mm_free_batch((void **)trace->batch_blocks, trace->ops[i].count);
+                break;
+
             default:
                 app_error("trace %d: Nonexistent request type in eval_mm_util",
                           tracenum);
         }
 
         /* update the high-water mark */
-        max_total_size = (total_size > max_total_size) ?
-            total_size : max_total_size;
-        heap_size = mem_heapsize();
+        if (total_size > max_total_size) {
+            max_total_size = total_size;
+            stats->peak_op = i;
+        }
+        heap_size = mem_heapsize() + mem_mapped();
         max_heap_size = (heap_size > max_heap_size) ?
             heap_size : max_heap_size;
+
+        /* sample the resident bytes at the end of each 1/RESIDENT_SAMPLES of the trace */
+        if (resident_mode && (long)(i + 1) * RESIDENT_SAMPLES >= (long)(sample + 1) * trace->num_ops) {
+            resident_size = mem_resident();
+            max_resident_size = (resident_size > max_resident_size) ?
+                resident_size : max_resident_size;
+            while (sample < RESIDENT_SAMPLES &&
+                   (long)(i + 1) * RESIDENT_SAMPLES >= (long)(sample + 1) * trace->num_ops)
+                stats->resident[sample++] = resident_size;
+        }
     }
 
 #if !REF_ONLY
     printf(".");
 #endif
 
+    stats->peak_heap = max_heap_size;
+    stats->peak_resident = max_resident_size;
+
     return ((double)max_total_size / (double)max_heap_size);
 }
 
@@ -1301,51 +1702,418 @@ static double eval_mm_util(trace_t *trace, int tracenum)
  */
 static void eval_mm_speed(void *ptr)
 {
-    int i, index;
-    size_t size, newsize;
-    char *p, *newp, *oldp, *block;
+    int i;
     trace_t *trace = ((speed_t *)ptr)->trace;
     reinit_trace(trace);
 
     /* Reset the heap and initialize the mm package */
-    mem_reset_brk();
+    if (fresh_heap)
+        mem_reset_heap();
+    else
+        mem_reset_brk();
     if (!mm_init())
         app_error("mm_init failed in eval_mm_speed");
 
     /* Interpret each trace request */
     for (i = 0;  i < trace->num_ops;  i++)
-        switch (trace->ops[i].type) {
+        replay_op(trace, i);
+}
 
-            case ALLOC: /* mm_malloc */
-                index = trace->ops[i].index;
-                size = trace->ops[i].size;
-                if ((p = mm_malloc(size)) == NULL)
-                    app_error("mm_malloc error in eval_mm_speed");
-                trace->blocks[index] = p;
-                break;
+/*
+ * replay_op - Runs request i of the trace on the mm malloc package,
+ *    without checking the blocks.
+ */
+static inline void replay_op(trace_t *trace, int i)
+{
+    int j, index;
+    size_t size, newsize;
+    char *p, *newp, *oldp, *block;
 
-            case REALLOC: /* mm_realloc */
-                index = trace->ops[i].index;
-                newsize = trace->ops[i].size;
-                oldp = trace->blocks[index];
-                if ((newp = mm_realloc(oldp,newsize)) == NULL && newsize != 0)
-                    app_error("mm_realloc error in eval_mm_speed");
-                trace->blocks[index] = newp;
-                break;
+    switch (trace->ops[i].type) {
 
-            case FREE: /* mm_free */
-                index = trace->ops[i].index;
-                if (index < 0) {
-                    block = 0;
-                } else {
-                    block = trace->blocks[index];
-                }
+        case ALLOC: /* mm_malloc */
+            index = trace->ops[i].index;
+            size = trace->ops[i].size;
+            if ((p = mm_malloc(size)) == NULL)
+                app_error("mm_malloc error in replay_op");
+            trace->blocks[index] = p;
+            trace->block_sizes[index] = size;
+            break;
+
+        case ALLOC_ALIGNED: /* mm_memalign */
+            index = trace->ops[i].index;
+            size = trace->ops[i].size;
+            if ((p = mm_memalign(trace->ops[i].alignment, size)) == NULL)
+                app_error("mm_memalign error in replay_op");
+            trace->blocks[index] = p;
+            trace->block_sizes[index] = size;
+            break;
+
+        case ALLOC_ZEROED: /* mm_calloc */
+            index = trace->ops[i].index;
+            size = trace->ops[i].size;
+            if ((p = mm_calloc(trace->ops[i].nmemb, size / trace->ops[i].nmemb)) == NULL)
+                app_error("mm_calloc error in replay_op");
+            trace->blocks[index] = p;
+            trace->block_sizes[index] = size;
+            break;
+
+        case REALLOC: /* mm_realloc */
+            index = trace->ops[i].index;
+            newsize = trace->ops[i].size;
+            oldp = trace->blocks[index];
+            if ((newp = mm_resize(oldp, trace->block_sizes[index], newsize)) == NULL
+                && newsize != 0)
+                app_error("mm_realloc error in replay_op");
+            trace->blocks[index] = newp;
+            trace->block_sizes[index] = newsize;
+            break;
+
+        case FREE: /* mm_free */
+            index = trace->ops[i].index;
+            if (index < 0) {
+                block = 0;
+                size = 0;
+            } else {
+                block = trace->blocks[index];
+                size = trace->block_sizes[index];
+                trace->blocks[index] = NULL;
+                trace->block_sizes[index] = 0;
+            }
+            if (sized_free)
+                mm_free_sized(block, size);
+            else
                 mm_free(block);
-                break;
+            break;
 
-            default:
-                app_error("Nonexistent request type in eval_mm_speed");
+        case ALLOC_BATCH: /* mm_malloc_batch */
+            if (mm_malloc_batch(trace->ops[i].size, trace->ops[i].count,
+                                (void **)trace->batch_blocks)
+                != (size_t)trace->ops[i].count)
+                app_error("mm_malloc_batch error in replay_op");
+            for (j = 0; j < trace->ops[i].count; j++) {
+                trace->blocks[trace->ops[i].indices[j]] = trace->batch_blocks[j];
+                trace->block_sizes[trace->ops[i].indices[j]] = trace->ops[i].size;
+            }
+            break;
+
+        case FREE_BATCH: /* mm_free_batch */
+            for (j = 0; j < trace->ops[i].count; j++) {
+                index = trace->ops[i].indices[j];
+                trace->batch_blocks[j] = trace->blocks[index];
+                trace->blocks[index] = NULL;
+                trace->block_sizes[index] = 0;
+            }
+            mm_free_batch((void **)trace->batch_blocks, trace->ops[i].count);
+            break;
+
+        default:
+            app_error("Nonexistent request type in replay_op");
+    }
+}
+
+/*
+ * open_counter - Opens a perf counter of the loads of this thread from
+ *    a cache (PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_L1D, ...) in
+ *    user mode, its misses if misses is set. Returns its file
+ *    descriptor, or -1 if perf counters are not available.
+ */
+static int open_counter(int cache, bool misses)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = cache |
+        (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+        ((misses ? PERF_COUNT_HW_CACHE_RESULT_MISS : PERF_COUNT_HW_CACHE_RESULT_ACCESS) << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/*
+ * eval_mm_tlb - Replays the trace up to the request after which the
+ *    most payload bytes are live, then reads WALK_STEPS random bytes of
+ *    the live blocks, once with huge pages off (MM_HUGEPAGES=0) and once
+ *    with huge pages on. The dTLB load misses of each walk (from the perf
+ *    counters, when the system has them), the time per access and the
+ *    heap bytes backed by huge pages are stored into stats.
+ */
+static void eval_mm_tlb(trace_t *trace, int tracenum, stats_t *stats)
+{
+    const char *saved = getenv("MM_HUGEPAGES");
+    char *saved_value = saved == NULL ? NULL : strdup(saved);
+    int *live = malloc(trace->num_ids * sizeof(int));
+    int mode, i, num_live;
+    volatile unsigned char sink = 0;
+
+    if (live == NULL)
+        unix_error("live malloc in eval_mm_tlb failed");
+
+    for (mode = 0; mode < 2; mode++) {
+        setenv("MM_HUGEPAGES", mode ? "1" : "0", 1);
+        reinit_trace(trace);
+
+        /* the small pages the previous runs faulted in would stay */
+        mm_purge(mem_heap_lo(), mem_heapsize());
+        mem_reset_brk();
+        if (!mm_init())
+            app_error("trace %d: mm_init failed in eval_mm_tlb", tracenum);
+
+        for (i = 0; i <= stats->peak_op && i < trace->num_ops; i++)
+            replay_op(trace, i);
+
+        num_live = 0;
+        for (i = 0; i < trace->num_ids; i++) {
+            if (trace->blocks[i] != NULL && trace->block_sizes[i] > 0)
+                live[num_live++] = i;
+        }
+
+        /* xorshift64, with the same sequence in both modes */
+        uint64_t x = 88172645463325252ULL;
+        int loads_fd = open_counter(PERF_COUNT_HW_CACHE_DTLB, false);
+        int misses_fd = open_counter(PERF_COUNT_HW_CACHE_DTLB, true);
+        struct timespec start, end;
+        uint64_t loads = 0, misses = 0;
+
+        if (loads_fd >= 0 && misses_fd >= 0) {
+            ioctl(loads_fd, PERF_EVENT_IOC_ENABLE, 0);
+            ioctl(misses_fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (i = 0; i < WALK_STEPS && num_live > 0; i++) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            int index = live[(x >> 32) % (uint64_t)num_live];
+            sink += (unsigned char)trace->blocks[index][x % trace->block_sizes[index]];
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        if (loads_fd >= 0 && misses_fd >= 0) {
+            ioctl(loads_fd, PERF_EVENT_IOC_DISABLE, 0);
+            ioctl(misses_fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+
+        stats->walk_ns[mode] = ((end.tv_sec - start.tv_sec) * 1e9 +
+                                (end.tv_nsec - start.tv_nsec)) / WALK_STEPS;
+        stats->tlb_misses[mode] = -1;
+        if (loads_fd >= 0 && misses_fd >= 0 &&
+            read(loads_fd, &loads, sizeof(loads)) == sizeof(loads) &&
+            read(misses_fd, &misses, sizeof(misses)) == sizeof(misses))
+            stats->tlb_misses[mode] = 1000.0 * misses / WALK_STEPS;
+        if (loads_fd >= 0)
+            close(loads_fd);
+        if (misses_fd >= 0)
+            close(misses_fd);
+        stats->huge_bytes[mode] = mem_huge_resident();
+    }
+
+    if (saved_value == NULL) {
+        unsetenv("MM_HUGEPAGES");
+    } else {
+        setenv("MM_HUGEPAGES", saved_value, 1);
+        free(saved_value);
+    }
+    free(live);
+    (void)sink;
+}
+
+/*
+ * read_tsc - Reads the time stamp counter, 0 where there is none
+ */
+static inline uint64_t read_tsc(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/*
+ * eval_mm_fit - Replays the trace FIT_RUNS times, reading the time stamp
+ *    counter around each mm_malloc. The fewest cycles per malloc of the
+ *    runs, less the cost of reading the counter, and the free list nodes
+ *    the fit scans visited per malloc (from mm_fit_nodes, when mm.c is
+ *    built with -DMM_FIT_STATS, as for mdriver-stats) are stored into stats.
+ */
+static void eval_mm_fit(trace_t *trace, int tracenum, stats_t *stats)
+{
+    uint64_t overhead = UINT64_MAX, cycles, nodes, start, elapsed;
+    long mallocs, before;
+    int run, i;
+
+    for (i = 0; i < 1000; i++) {
+        start = read_tsc();
+        cycles = read_tsc() - start;
+        if (cycles < overhead)
+            overhead = cycles;
+    }
+
+    stats->fit_nodes = -1;
+    stats->malloc_cycles = -1;
+
+    for (run = 0; run < FIT_RUNS; run++) {
+        reinit_trace(trace);
+        mem_reset_brk();
+        if (!mm_init())
+            app_error("trace %d: mm_init failed in eval_mm_fit", tracenum);
+
+        cycles = 0;
+        nodes = 0;
+        mallocs = 0;
+        for (i = 0; i < trace->num_ops; i++) {
+            if (trace->ops[i].type != ALLOC) {
+                replay_op(trace, i);
+                continue;
+            }
+            before = mm_fit_nodes();
+            start = read_tsc();
+            replay_op(trace, i);
+            elapsed = read_tsc() - start;
+            cycles += elapsed > overhead ? elapsed - overhead : 0;
+            nodes += (uint64_t)(mm_fit_nodes() - before);
+            mallocs++;
         }
+
+        if (mallocs == 0)
+            return;
+        if (mm_fit_nodes() >= 0)
+            stats->fit_nodes = (double)nodes / mallocs;
+        if (cycles > 0 && (stats->malloc_cycles < 0 ||
+                           (double)cycles / mallocs < stats->malloc_cycles))
+            stats->malloc_cycles = (double)cycles / mallocs;
+    }
+}
+
+/*
+ * eval_mm_cache - Replays the trace once and stores into stats the
+ *    metadata accesses (headers, footers and free list links) and the
+ *    misses per mm_free of a modeled 32 KiB, 8-way LRU data cache (from
+ *    mm_cache_accesses and mm_cache_misses, when mm.c is built with
+ *    -DMM_CACHE_MODEL, as for mdriver-cache).
+ */
+static void eval_mm_cache(trace_t *trace, int tracenum, stats_t *stats)
+{
+    long accesses = 0, misses = 0, frees = 0, accesses_before, misses_before;
+    int i;
+
+    stats->free_accesses = -1;
+    stats->free_misses = -1;
+
+    reinit_trace(trace);
+    mem_reset_brk();
+    if (!mm_init())
+        app_error("trace %d: mm_init failed in eval_mm_cache", tracenum);
+
+    for (i = 0; i < trace->num_ops; i++) {
+        if (trace->ops[i].type != FREE) {
+            replay_op(trace, i);
+            continue;
+        }
+        accesses_before = mm_cache_accesses();
+        misses_before = mm_cache_misses();
+        replay_op(trace, i);
+        accesses += mm_cache_accesses() - accesses_before;
+        misses += mm_cache_misses() - misses_before;
+        frees++;
+    }
+
+    if (frees == 0 || mm_cache_accesses() < 0)
+        return;
+    stats->free_accesses = (double)accesses / frees;
+    stats->free_misses = (double)misses / frees;
+}
+
+/*
+ * eval_mm_coloring - Allocates n blocks of 4 KiB, then of 64 KiB, in a
+ *    row and reads them a cache line of each block in turn, as a loop
+ *    over n buffers at once does, once with cache coloring off
+ *    (MM_COLORING=0) and once on. Prints the L1 data cache misses per
+ *    line read (from the perf counters, when the system has them) and
+ *    the time per line read.
+ */
+static void eval_mm_coloring(int n)
+{
+    static const size_t sizes[] = { 4096, 65536 };
+    const char *saved = getenv("MM_COLORING");
+    char *saved_value = saved == NULL ? NULL : strdup(saved);
+    unsigned char **blocks = malloc(n * sizeof(*blocks));
+    volatile unsigned char sink = 0;
+    int s, mode, b;
+
+    if (blocks == NULL)
+        unix_error("blocks malloc in eval_mm_coloring failed");
+
+    printf("Streaming through %d blocks at once (%d lines):\n", n, STREAM_LINES);
+    printf("  %9s  %-19s  %-19s\n", "", "coloring off", "coloring on");
+    printf("  %9s  %9s %9s  %9s %9s\n", "block", "miss/line", "ns/line",
+           "miss/line", "ns/line");
+
+    mem_init();
+    for (s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+        size_t size = sizes[s];
+        long passes = STREAM_LINES / ((long)n * (long)(size / CACHE_LINE));
+
+        if (passes < 1)
+            passes = 1;
+        printf("  %9zu ", size);
+        for (mode = 0; mode < 2; mode++) {
+            setenv("MM_COLORING", mode ? "1" : "0", 1);
+            mem_reset_brk();
+            if (!mm_init())
+                app_error("mm_init failed in eval_mm_coloring");
+            for (b = 0; b < n; b++) {
+                if ((blocks[b] = mm_malloc(size)) == NULL)
+                    app_error("mm_malloc failed in eval_mm_coloring");
+                memset(blocks[b], b, size);
+            }
+
+            int misses_fd = open_counter(PERF_COUNT_HW_CACHE_L1D, true);
+            uint64_t misses = 0;
+            struct timespec start, end;
+
+            if (misses_fd >= 0)
+                ioctl(misses_fd, PERF_EVENT_IOC_ENABLE, 0);
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (long pass = 0; pass < passes; pass++) {
+                for (size_t offset = 0; offset < size; offset += CACHE_LINE) {
+                    for (b = 0; b < n; b++)
+                        sink += blocks[b][offset];
+                }
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            if (misses_fd >= 0)
+                ioctl(misses_fd, PERF_EVENT_IOC_DISABLE, 0);
+
+            double lines = (double)passes * n * (size / CACHE_LINE);
+            if (misses_fd >= 0 && read(misses_fd, &misses, sizeof(misses)) == sizeof(misses))
+                printf(" %9.3f", misses / lines);
+            else
+                printf(" %9s", "n/a");
+            if (misses_fd >= 0)
+                close(misses_fd);
+            printf(" %9.2f ", ((end.tv_sec - start.tv_sec) * 1e9 +
+                               (end.tv_nsec - start.tv_nsec)) / lines);
+
+            for (b = 0; b < n; b++)
+                mm_free(blocks[b]);
+        }
+        printf("\n");
+    }
+    mem_deinit();
+
+    if (saved_value == NULL) {
+        unsetenv("MM_COLORING");
+    } else {
+        setenv("MM_COLORING", saved_value, 1);
+        free(saved_value);
+    }
+    free(blocks);
+    (void)sink;
 }
 
 /*
@@ -1356,7 +2124,7 @@ static void eval_mm_speed(void *ptr)
  */
 static bool eval_libc_valid(trace_t *trace)
 {
-    int i;
+    int i, j;
     size_t newsize;
     char *p, *newp, *oldp;
 
@@ -1373,6 +2141,24 @@ static bool eval_libc_valid(trace_t *trace)
                 trace->blocks[trace->ops[i].index] = p;
                 break;
 
+            case ALLOC_ALIGNED: /* posix_memalign */
+                if (posix_memalign((void **)&p, trace->ops[i].alignment,
+                                   trace->ops[i].size) != 0) {
+                    malloc_error(trace, i, "libc posix_memalign failed");
+                    unix_error("System message");
+                }
+                trace->blocks[trace->ops[i].index] = p;
+                break;
+
+            case ALLOC_ZEROED: /* calloc */
+                if ((p = calloc(trace->ops[i].nmemb,
+                                trace->ops[i].size / trace->ops[i].nmemb)) == NULL) {
+                    malloc_error(trace, i, "libc calloc failed");
+                    unix_error("System message");
+                }
+                trace->blocks[trace->ops[i].index] = p;
+                break;
+
             case REALLOC: /* realloc */
                 newsize = trace->ops[i].size;
                 oldp = trace->blocks[trace->ops[i].index];
@@ -1391,6 +2177,22 @@ static bool eval_libc_valid(trace_t *trace)
                 }
                 break;
 
+            case ALLOC_BATCH: /* one malloc per block */
+                for (j = 0; j < trace->ops[i].count; j++) {
+                    if ((p = malloc(trace->ops[i].size)) == NULL) {
+                        malloc_error(trace, i, "libc malloc failed");
+                        unix_error("System message");
+                    }
+                    trace->blocks[trace->ops[i].indices[j]] = p;
+                }
+                break;
+
+            case FREE_BATCH: /* one free per block */
+                for (j = 0; j < trace->ops[i].count; j++) {
+                    free(trace->blocks[trace->ops[i].indices[j]]);
+                }
+                break;
+
             default:
                 app_error("invalid operation type  in eval_libc_valid");
         }
@@ -1406,7 +2208,7 @@ static bool eval_libc_valid(trace_t *trace)
  */
 static void eval_libc_speed(void *ptr)
 {
-    int i;
+    int i, j;
     int index;
     size_t size, newsize;
     char *p, *newp, *oldp, *block;
@@ -1424,6 +2226,22 @@ static void eval_libc_speed(void *ptr)
                 trace->blocks[index] = p;
                 break;
 
+            case ALLOC_ALIGNED: /* posix_memalign */
+                index = trace->ops[i].index;
+                size = trace->ops[i].size;
+                if (posix_memalign((void **)&p, trace->ops[i].alignment, size) != 0)
+                    unix_error("posix_memalign failed in eval_libc_speed");
+                trace->blocks[index] = p;
+                break;
+
+            case ALLOC_ZEROED: /* calloc */
+                index = trace->ops[i].index;
+                size = trace->ops[i].size;
+                if ((p = calloc(trace->ops[i].nmemb, size / trace->ops[i].nmemb)) == NULL)
+                    unix_error("calloc failed in eval_libc_speed");
+                trace->blocks[index] = p;
+                break;
+
             case REALLOC: /* realloc */
                 index = trace->ops[i].index;
                 newsize = trace->ops[i].size;
@@ -1443,6 +2261,20 @@ static void eval_libc_speed(void *ptr)
                     free(0);
                 }
                 break;
+
+            case ALLOC_BATCH: /* one malloc per block */
+                size = trace->ops[i].size;
+                for (j = 0; j < trace->ops[i].count; j++) {
+                    if ((p = malloc(size)) == NULL)
+                        unix_error("malloc failed in eval_libc_speed");
+                    trace->blocks[trace->ops[i].indices[j]] = p;
+                }
+                break;
+
+            case FREE_BATCH: /* one free per block */
+                for (j = 0; j < trace->ops[i].count; j++)
+                    free(trace->blocks[trace->ops[i].indices[j]]);
+                break;
         }
     }
 }
@@ -1452,6 +2284,102 @@ static void eval_libc_speed(void *ptr)
  ************************************/
 
 
+/*
+ * printresident - prints the resident heap bytes of each valid trace
+ *                 over time (-r), next to its peak heap size
+ */
+static void printresident(int n, stats_t *stats)
+{
+    int i, j;
+
+    printf("Resident heap (KiB at each 1/%d of the trace):\n", RESIDENT_SAMPLES);
+    printf("  %9s %9s  %s\n", "peak heap", "peak rss", "resident over time");
+    for (i = 0; i < n; i++) {
+        if (!stats[i].valid)
+            continue;
+        printf("  %9zu %9zu ", stats[i].peak_heap / 1024,
+               stats[i].peak_resident / 1024);
+        for (j = 0; j < RESIDENT_SAMPLES; j++)
+            printf(" %zu", stats[i].resident[j] / 1024);
+        printf("  %s\n", stats[i].filename);
+    }
+}
+
+/*
+ * printtlb - prints the dTLB misses and the time per access of the walk
+ *            over the live blocks of each valid trace (-H), with huge
+ *            pages off and on, next to the heap bytes huge pages backed
+ */
+static void printtlb(int n, stats_t *stats)
+{
+    int i, mode;
+
+    printf("Random walk over the live blocks at peak (%d reads):\n", WALK_STEPS);
+    printf("  %-31s %-31s\n", "huge pages off", "huge pages on");
+    printf("  %9s %9s %9s  %9s %9s %9s\n", "miss/1k", "ns/read", "THP KiB",
+           "miss/1k", "ns/read", "THP KiB");
+    for (i = 0; i < n; i++) {
+        if (!stats[i].valid)
+            continue;
+        printf(" ");
+        for (mode = 0; mode < 2; mode++) {
+            if (stats[i].tlb_misses[mode] < 0)
+                printf(" %9s", "n/a");
+            else
+                printf(" %9.2f", stats[i].tlb_misses[mode]);
+            printf(" %9.2f %9zu ", stats[i].walk_ns[mode],
+                   stats[i].huge_bytes[mode] / 1024);
+        }
+        printf(" %s\n", stats[i].filename);
+    }
+}
+
+/*
+ * printfit - prints the free list nodes the fit scans visited and the
+ *            cycles spent per malloc of each valid trace (-S)
+ */
+static void printfit(int n, stats_t *stats)
+{
+    int i;
+
+    printf("Fit scans per malloc (fewest cycles of %d runs):\n", FIT_RUNS);
+    printf("  %9s %9s\n", "nodes", "cycles");
+    for (i = 0; i < n; i++) {
+        if (!stats[i].valid)
+            continue;
+        if (stats[i].fit_nodes < 0)
+            printf("  %9s", "n/a");
+        else
+            printf("  %9.2f", stats[i].fit_nodes);
+        if (stats[i].malloc_cycles < 0)
+            printf(" %9s", "n/a");
+        else
+            printf(" %9.1f", stats[i].malloc_cycles);
+        printf("  %s\n", stats[i].filename);
+    }
+}
+
+/*
+ * printcache - prints the metadata accesses and the misses of the
+ *              modeled cache per free of each valid trace (-M)
+ */
+static void printcache(int n, stats_t *stats)
+{
+    int i;
+
+    printf("Modeled cache (32 KiB, 8-way LRU) per free:\n");
+    printf("  %9s %9s\n", "accesses", "misses");
+    for (i = 0; i < n; i++) {
+        if (!stats[i].valid)
+            continue;
+        if (stats[i].free_accesses < 0)
+            printf("  %9s %9s", "n/a", "n/a");
+        else
+            printf("  %9.2f %9.2f", stats[i].free_accesses, stats[i].free_misses);
+        printf("  %s\n", stats[i].filename);
+    }
+}
+
 /*
  * printresults - prints a performance summary for some malloc package and returns
  *                a summary of the stats to the caller. 
@@ -1828,7 +2756,7 @@ static double measure_ref_throughput() {
  */
 static void usage(char *prog)
 {
-    fprintf(stderr, "Usage: %s [-hlVdD] [-f <file>]\n", prog);
+    fprintf(stderr, "Usage: %s [-hlVdDzxrHSZ] [-C <n>] [-f <file>]\n", prog);
     fprintf(stderr, "Options\n");
     fprintf(stderr, "\t-d <i>     Debug: 0 off; 1 default; 2 lots.\n");
     fprintf(stderr, "\t-D         Equivalent to -d2.\n");
@@ -1840,5 +2768,13 @@ static void usage(char *prog)
     fprintf(stderr, "\t-v <i>     Set Verbosity Level to <i>\n");
     fprintf(stderr, "\t-s <s>     Timeout after s secs (default no timeout)\n");
     fprintf(stderr, "\t-T         Print diagnostics in tab mode\n");
+    fprintf(stderr, "\t-z         Free blocks with mm_free_sized\n");
+    fprintf(stderr, "\t-x         Grow blocks in place with mm_try_expand before mm_realloc\n");
+    fprintf(stderr, "\t-r         Report resident heap bytes over time\n");
+    fprintf(stderr, "\t-H         Report dTLB misses with huge pages off and on\n");
+    fprintf(stderr, "\t-S         Report fit scan nodes (mdriver-stats) and cycles per malloc\n");
+    fprintf(stderr, "\t-M         Report metadata accesses and modeled cache misses per free (mdriver-cache)\n");
+    fprintf(stderr, "\t-Z         Give the heap back before each timed run, so it starts on zero pages\n");
+    fprintf(stderr, "\t-C <n>     Stream through <n> large blocks at once with cache coloring off and on\n");
     fprintf(stderr, "\t-f <file>  Use <file> as the trace file\n");
 }
@@ -4,6 +4,7 @@
  * package with the system's malloc package in libc.
  *
  */
+#define _GNU_SOURCE             /* for mremap */
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -14,6 +15,9 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdint.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 #include "memlib.h"
 #include "config.h"
@@ -22,19 +26,85 @@
 static unsigned char *heap;                 /* Starting address of heap */
 static unsigned char *mem_brk;              /* Current position of break */
 static unsigned char *mem_max_addr;         /* Maximum allowable heap address */
+static unsigned char *region_brk[MM_MAX_REGIONS]; /* Break of each region but region 0 */
+static unsigned char *region_clean[MM_MAX_REGIONS]; /* Each region is zero from here to its end */
+
+/* A mapping made by mm_map, outside the reserved space */
+typedef struct mapping_t {
+    unsigned char *addr;
+    size_t size;
+    struct mapping_t *next;
+} mapping_t;
+
+static mapping_t *mappings;                 /* Live mappings, most recent first */
+static size_t mapped_bytes;                 /* Total size of the live mappings */
+
+static size_t huge_page_size;               /* Size of a transparent huge page */
+static bool huge_advised;                   /* Heap and new mappings advised as huge page eligible */
+
+/* Copy and set kernels for the CPU, chosen by mem_init */
+static void copy_words(unsigned char *dst, const unsigned char *src, size_t n);
+static void set_words(unsigned char *dst, int c, size_t n);
+static void (*copy_kernel)(unsigned char *dst, const unsigned char *src, size_t n) = copy_words;
+static void (*set_kernel)(unsigned char *dst, int c, size_t n) = set_words;
+static size_t stream_threshold;             /* Copies and sets of this many bytes bypass the caches */
+
+/* The reserved space is split into MM_MAX_REGIONS equal regions */
+#define REGION_SIZE (MAX_HEAP_SIZE / MM_MAX_REGIONS)
+
+/* Pages whose residency mincore reports in one call */
+#define RESIDENT_CHUNK_PAGES 4096
+
+/* Transparent huge page size, when the kernel does not report it */
+#define DEFAULT_HUGE_PAGE_SIZE (2UL << 20)
+
+/* Last level cache size, when the system does not report it */
+#define DEFAULT_LLC_SIZE (8UL << 20)
+
+/*
+ * release_pages - drops the pages wholly inside [lo, hi), as
+ *           madvise(MADV_DONTNEED) does. They read as zero on the
+ *           next touch, which faults them in again.
+ */
+static void release_pages(unsigned char *lo, unsigned char *hi) {
+    uintptr_t page = (uintptr_t) getpagesize();
+    uintptr_t start = ((uintptr_t) lo + page - 1) & ~(page - 1);
+    uintptr_t end = (uintptr_t) hi & ~(page - 1);
+
+    if (start < end)
+	madvise((void *) start, end - start, MADV_DONTNEED);
+}
+
+/*
+ * shrink_break - gives back the pages past a break that shrank from
+ *           old_brk to new_brk, with the page holding old_brk, which
+ *           keeps no heap bytes, and records that the region is zero
+ *           again from the page boundary after new_brk, unless bytes
+ *           past that page were written before
+ */
+static void shrink_break(unsigned char **clean, unsigned char *new_brk, unsigned char *old_brk) {
+    uintptr_t page = (uintptr_t) getpagesize();
+    unsigned char *lo = (unsigned char *) (((uintptr_t) new_brk + page - 1) & ~(page - 1));
+    unsigned char *hi = (unsigned char *) (((uintptr_t) old_brk + page - 1) & ~(page - 1));
+
+    release_pages(lo, hi);
+    if (hi >= *clean && lo < *clean)
+	*clean = lo;
+}
 
 /* 
  * mm_sbrk - simple model of the sbrk function. Extends the heap 
  *           by incr bytes and returns the start address of the
- *           new area. In this model, the heap cannot be shrunk.
+ *           new area. A negative incr shrinks the heap, and the
+ *           pages wholly past the new break are given back.
  */
 void *mm_sbrk(intptr_t incr) {
     unsigned char *old_brk = mem_brk;
 
     bool ok = true;
-    if (incr < 0) {
+    if (incr < 0 && mem_brk + incr < heap) {
 	ok = false;
-	fprintf(stderr, "ERROR: mm_sbrk failed.  Attempt to expand heap by negative value %ld\n", (long) incr);
+	fprintf(stderr, "ERROR: mm_sbrk failed.  Attempt to shrink heap by %ld below its start\n", (long) -incr);
     } else if (mem_brk + incr > mem_max_addr) {
 	ok = false;
 	long alloc = mem_brk - heap + incr;
@@ -42,6 +112,11 @@ void *mm_sbrk(intptr_t incr) {
     }
     if (ok) {
 	mem_brk += incr;
+	if (incr < 0) {
+	    shrink_break(&region_clean[0], mem_brk, old_brk);
+	} else if (mem_brk > region_clean[0]) {
+	    region_clean[0] = mem_brk;
+	}
 	return (void *) old_brk;
     } else {
 	errno = ENOMEM;
@@ -49,6 +124,200 @@ void *mm_sbrk(intptr_t incr) {
     }
 }
 
+/*
+ * mm_region_sbrk - mm_sbrk for one region of the reserved space.
+ *           Region 0 is the heap grown by mm_sbrk; region r > 0 starts
+ *           at r * REGION_SIZE bytes past the heap start and has its own
+ *           break. A region cannot grow past REGION_SIZE bytes, nor
+ *           shrink below its start. Callers must serialize calls for
+ *           the same region.
+ */
+void *mm_region_sbrk(int region, intptr_t incr) {
+    if (region < 0 || region >= MM_MAX_REGIONS) {
+	fprintf(stderr, "ERROR: mm_region_sbrk failed.  Invalid region %d\n", region);
+	errno = EINVAL;
+	return (void *) -1;
+    }
+
+    unsigned char *start = heap + (size_t) region * REGION_SIZE;
+    unsigned char **brk = region == 0 ? &mem_brk : &region_brk[region];
+    unsigned char *old_brk = *brk;
+
+    if (old_brk + incr < start) {
+	fprintf(stderr, "ERROR: mm_region_sbrk failed.  Attempt to shrink region %d by %ld below its start\n", region, (long) -incr);
+	errno = EINVAL;
+	return (void *) -1;
+    }
+    if (old_brk + incr > start + REGION_SIZE) {
+	fprintf(stderr, "ERROR: mm_region_sbrk failed. Ran out of memory in region %d\n", region);
+	errno = ENOMEM;
+	return (void *) -1;
+    }
+    *brk += incr;
+    if (incr < 0) {
+	shrink_break(&region_clean[region], *brk, old_brk);
+    } else if (*brk > region_clean[region]) {
+	region_clean[region] = *brk;
+    }
+    return (void *) old_brk;
+}
+
+/*
+ * mm_region_of - return the region holding a heap address
+ */
+int mm_region_of(const void *ptr) {
+    return (int) (((const unsigned char *) ptr - heap) / REGION_SIZE);
+}
+
+/*
+ * mm_purge - gives back the pages wholly inside the len bytes at addr,
+ *           which must lie below the break. Their contents are lost:
+ *           they read as zero when next touched. Returns 0, or -1 if
+ *           the range is outside the reserved space.
+ */
+int mm_purge(void *addr, size_t len) {
+    unsigned char *lo = (unsigned char *) addr;
+
+    if (lo < heap || lo + len > mem_max_addr) {
+	fprintf(stderr, "ERROR: mm_purge failed.  Range %p + %zu is outside the heap\n", addr, len);
+	errno = EINVAL;
+	return -1;
+    }
+    release_pages(lo, lo + len);
+    return 0;
+}
+
+/*
+ * align_mapping - trims the extra bytes mapped past size bytes at addr
+ *           so that what remains starts at a multiple of extra, a power
+ *           of two, and returns its start
+ */
+static void *align_mapping(void *addr, size_t size, size_t extra) {
+    uintptr_t lo = (uintptr_t) addr;
+    uintptr_t start = (lo + extra - 1) & ~(extra - 1);
+
+    if (start > lo)
+	munmap(addr, start - lo);
+    if (lo + extra > start)
+	munmap((void *) (start + size), lo + extra - start);
+    return (void *) start;
+}
+
+/*
+ * mm_known_zero - returns whether every byte from addr, which must lie
+ *           in the reserved space, to the end of its region is zero.
+ *           This holds past the highest break the region has had, and
+ *           past the pages given back by the break shrinking since.
+ */
+bool mm_known_zero(const void *addr) {
+    int region = mm_region_of(addr);
+
+    return region >= 0 && region < MM_MAX_REGIONS &&
+	(const unsigned char *) addr >= region_clean[region];
+}
+
+/*
+ * find_mapping - return the link to the record of the mapping at addr,
+ *           NULL if there is none
+ */
+static mapping_t **find_mapping(const void *addr) {
+    mapping_t **link = &mappings;
+
+    while (*link != NULL && (*link)->addr != addr)
+	link = &(*link)->next;
+    return *link != NULL ? link : NULL;
+}
+
+/*
+ * mm_map - model of an anonymous mmap. Returns a new zeroed mapping of
+ *           size bytes, rounded up to pages, outside the heap, or
+ *           (void *) -1 on error. Callers must serialize the mm_map,
+ *           mm_unmap and mm_remap calls.
+ */
+void *mm_map(size_t size) {
+    size_t page = (size_t) getpagesize();
+    mapping_t *m = malloc(sizeof(mapping_t));
+
+    size = (size + page - 1) & ~(page - 1);
+    size_t extra = huge_advised ? huge_page_size : 0;
+    void *addr = size == 0 || m == NULL ? MAP_FAILED :
+	mmap(NULL, size + extra, PROT_READ | PROT_WRITE,
+	     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (addr == MAP_FAILED) {
+	fprintf(stderr, "ERROR: mm_map failed.  Could not map %zu bytes\n", size);
+	free(m);
+	errno = ENOMEM;
+	return (void *) -1;
+    }
+    if (extra) {
+	addr = align_mapping(addr, size, extra);
+	madvise(addr, size, MADV_HUGEPAGE);
+    }
+    m->addr = addr;
+    m->size = size;
+    m->next = mappings;
+    mappings = m;
+    mapped_bytes += size;
+    return addr;
+}
+
+/*
+ * mm_unmap - removes a whole mapping made by mm_map or mm_remap.
+ *           Returns 0, or -1 if addr is not the start of a mapping.
+ */
+int mm_unmap(void *addr) {
+    mapping_t **link = find_mapping(addr);
+
+    if (link == NULL) {
+	fprintf(stderr, "ERROR: mm_unmap failed.  No mapping at %p\n", addr);
+	errno = EINVAL;
+	return -1;
+    }
+    mapping_t *m = *link;
+    munmap(m->addr, m->size);
+    mapped_bytes -= m->size;
+    *link = m->next;
+    free(m);
+    return 0;
+}
+
+/*
+ * mm_remap - model of mremap. Resizes the mapping at addr to size bytes,
+ *           rounded up to pages, by moving its pages rather than copying
+ *           them. The mapping stays in place unless may_move is set.
+ *           Returns its new address, or (void *) -1 if it cannot be
+ *           resized (in place, without may_move).
+ */
+void *mm_remap(void *addr, size_t size, bool may_move) {
+    size_t page = (size_t) getpagesize();
+    mapping_t **link = find_mapping(addr);
+
+    size = (size + page - 1) & ~(page - 1);
+    if (link == NULL || size == 0) {
+	fprintf(stderr, "ERROR: mm_remap failed.  No mapping at %p or empty size\n", addr);
+	errno = EINVAL;
+	return (void *) -1;
+    }
+    mapping_t *m = *link;
+    void *new_addr = mremap(m->addr, m->size, size, may_move ? MREMAP_MAYMOVE : 0);
+    if (new_addr == MAP_FAILED) {
+	errno = ENOMEM;
+	return (void *) -1;
+    }
+    mapped_bytes += size - m->size;
+    m->addr = new_addr;
+    m->size = size;
+    return new_addr;
+}
+
+/*
+ * unmap_all - removes every mapping made by mm_map
+ */
+static void unmap_all(void) {
+    while (mappings != NULL)
+	mm_unmap(mappings->addr);
+}
+
 /*
  * mm_heap_lo - return address of the first heap byte
  */
@@ -78,30 +347,52 @@ size_t mm_pagesize(){
 }
 
 /*
- * mm_memcpy - copies n bytes from src to dst
+ * mm_hugepagesize - returns the size of a transparent huge page, to
+ *           which the start of the heap and of each region is aligned
  */
-void *mm_memcpy(void *dst, const void *src, size_t n) {
-    void *savedst = dst;
+size_t mm_hugepagesize(void) {
+    return huge_page_size;
+}
+
+/*
+ * mm_advise_huge - advises the whole reserved space, and the mappings
+ *           made from now on, as eligible for transparent huge pages, as
+ *           madvise(MADV_HUGEPAGE) does, or undoes an earlier advice.
+ *           Returns 0, or -1 if the kernel does not support it.
+ */
+int mm_advise_huge(bool enable) {
+    if (enable == huge_advised)
+	return 0;
+    if (madvise(heap, MAX_HEAP_SIZE, enable ? MADV_HUGEPAGE : MADV_NOHUGEPAGE) != 0)
+	return -1;
+    huge_advised = enable;
+    return 0;
+}
+
+/*
+ * copy_words - copies n bytes from src to dst a word at a time, through
+ *           mem_read and mem_write
+ */
+static void copy_words(unsigned char *dst, const unsigned char *src, size_t n) {
     size_t w = sizeof(uint64_t);
     while (n >= w) {
 	uint64_t data = mem_read(src, w);
 	mem_write(dst, data, w);
 	n -= w;
-	src = (void *) ((unsigned char *) src + w);
-	dst = (void *) ((unsigned char *) dst + w);
+	src += w;
+	dst += w;
     }
     if (n) {
 	uint64_t data = mem_read(src, n);
 	mem_write(dst, data, n);
     }
-    return savedst;
 }
 
 /*
- * mm_memset - sets the first n bytes of memory pointed to by dst to c
+ * set_words - sets n bytes at dst to c a word at a time, through
+ *           mem_write
  */
-void *mm_memset(void *dst, int c, size_t n) {
-    void *savedst = dst;
+static void set_words(unsigned char *dst, int c, size_t n) {
     uint64_t byte = c & 0xFF;
     uint64_t data = 0;
     size_t w = sizeof(uint64_t);
@@ -112,22 +403,191 @@ void *mm_memset(void *dst, int c, size_t n) {
     while (n >= w) {
 	mem_write(dst, data, w);
 	n -= w;
-	dst = (void *) ((unsigned char *) dst + w);
+	dst += w;
     }
     if (n) {
 	mem_write(dst, data, n);	
     }
-    return savedst;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/*
+ * The vector kernels store the first and last vector of the range
+ * unaligned, and the vectors in between aligned to dst, so they never
+ * touch a byte outside the range. From stream_threshold bytes on, the
+ * aligned stores are non-temporal, which keeps a copy or set larger
+ * than the last level cache from evicting it.
+ */
+
+/*
+ * copy_sse2 - copies n bytes from src to dst 16 bytes at a time
+ */
+__attribute__((target("sse2")))
+static void copy_sse2(unsigned char *dst, const unsigned char *src, size_t n) {
+    if (n < 16) {
+	copy_words(dst, src, n);
+	return;
+    }
+    __m128i head = _mm_loadu_si128((const __m128i *) src);
+    __m128i tail = _mm_loadu_si128((const __m128i *) (src + n - 16));
+    size_t i = 16 - ((uintptr_t) dst & 15);
+    if (n >= stream_threshold) {
+	for (; i + 16 <= n; i += 16)
+	    _mm_stream_si128((__m128i *) (dst + i), _mm_loadu_si128((const __m128i *) (src + i)));
+	_mm_sfence();
+    } else {
+	for (; i + 16 <= n; i += 16)
+	    _mm_store_si128((__m128i *) (dst + i), _mm_loadu_si128((const __m128i *) (src + i)));
+    }
+    _mm_storeu_si128((__m128i *) dst, head);
+    _mm_storeu_si128((__m128i *) (dst + n - 16), tail);
+}
+
+/*
+ * set_sse2 - sets n bytes at dst to c 16 bytes at a time
+ */
+__attribute__((target("sse2")))
+static void set_sse2(unsigned char *dst, int c, size_t n) {
+    if (n < 16) {
+	set_words(dst, c, n);
+	return;
+    }
+    __m128i data = _mm_set1_epi8((char) c);
+    size_t i = 16 - ((uintptr_t) dst & 15);
+    _mm_storeu_si128((__m128i *) dst, data);
+    if (n >= stream_threshold) {
+	for (; i + 16 <= n; i += 16)
+	    _mm_stream_si128((__m128i *) (dst + i), data);
+	_mm_sfence();
+    } else {
+	for (; i + 16 <= n; i += 16)
+	    _mm_store_si128((__m128i *) (dst + i), data);
+    }
+    _mm_storeu_si128((__m128i *) (dst + n - 16), data);
+}
+
+/*
+ * copy_avx2 - copies n bytes from src to dst 32 bytes at a time
+ */
+__attribute__((target("avx2")))
+static void copy_avx2(unsigned char *dst, const unsigned char *src, size_t n) {
+    if (n < 32) {
+	copy_sse2(dst, src, n);
+	return;
+    }
+    __m256i head = _mm256_loadu_si256((const __m256i *) src);
+    __m256i tail = _mm256_loadu_si256((const __m256i *) (src + n - 32));
+    size_t i = 32 - ((uintptr_t) dst & 31);
+    if (n >= stream_threshold) {
+	for (; i + 32 <= n; i += 32)
+	    _mm256_stream_si256((__m256i *) (dst + i), _mm256_loadu_si256((const __m256i *) (src + i)));
+	_mm_sfence();
+    } else {
+	for (; i + 32 <= n; i += 32)
+	    _mm256_store_si256((__m256i *) (dst + i), _mm256_loadu_si256((const __m256i *) (src + i)));
+    }
+    _mm256_storeu_si256((__m256i *) dst, head);
+    _mm256_storeu_si256((__m256i *) (dst + n - 32), tail);
+}
+
+/*
+ * set_avx2 - sets n bytes at dst to c 32 bytes at a time
+ */
+__attribute__((target("avx2")))
+static void set_avx2(unsigned char *dst, int c, size_t n) {
+    if (n < 32) {
+	set_sse2(dst, c, n);
+	return;
+    }
+    __m256i data = _mm256_set1_epi8((char) c);
+    size_t i = 32 - ((uintptr_t) dst & 31);
+    _mm256_storeu_si256((__m256i *) dst, data);
+    if (n >= stream_threshold) {
+	for (; i + 32 <= n; i += 32)
+	    _mm256_stream_si256((__m256i *) (dst + i), data);
+	_mm_sfence();
+    } else {
+	for (; i + 32 <= n; i += 32)
+	    _mm256_store_si256((__m256i *) (dst + i), data);
+    }
+    _mm256_storeu_si256((__m256i *) (dst + n - 32), data);
+}
+
+#endif
+
+/*
+ * select_kernels - chooses the widest copy and set kernels the CPU
+ *           supports, and the size from which they bypass the caches,
+ *           the size of the last level cache
+ */
+static void select_kernels(void) {
+    copy_kernel = copy_words;
+    set_kernel = set_words;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+	copy_kernel = copy_avx2;
+	set_kernel = set_avx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+	copy_kernel = copy_sse2;
+	set_kernel = set_sse2;
+    }
+#endif
+    long llc_size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (llc_size <= 0)
+	llc_size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    stream_threshold = llc_size > 0 ? (size_t) llc_size : DEFAULT_LLC_SIZE;
+}
+
+/*
+ * mm_memcpy - copies n bytes from src to dst, which must not overlap
+ */
+void *mm_memcpy(void *dst, const void *src, size_t n) {
+    copy_kernel((unsigned char *) dst, (const unsigned char *) src, n);
+    return dst;
+}
+
+/*
+ * mm_memset - sets the first n bytes of memory pointed to by dst to c
+ */
+void *mm_memset(void *dst, int c, size_t n) {
+    set_kernel((unsigned char *) dst, c, n);
+    return dst;
 }
 
 /*************** Memory emulation  *******************/
 
+/*
+ * read_huge_page_size - returns the transparent huge page size the
+ *           kernel reports, or DEFAULT_HUGE_PAGE_SIZE
+ */
+static size_t read_huge_page_size(void) {
+    size_t size = 0;
+    FILE *fp = fopen("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r");
+
+    if (fp != NULL) {
+	if (fscanf(fp, "%zu", &size) != 1)
+	    size = 0;
+	fclose(fp);
+    }
+    /* a power of two, at least a page */
+    if (size < (size_t) getpagesize() || (size & (size - 1)) != 0)
+	size = DEFAULT_HUGE_PAGE_SIZE;
+    return size;
+}
+
 /* 
  * mem_init - initialize the memory system model
  */
 void mem_init(){
+    huge_page_size = read_huge_page_size();
+    huge_advised = false;
+    select_kernels();
+
+    /* over-reserve by a huge page, so that the heap can start on a huge page boundary */
     unsigned char* addr = mmap(NULL,                                        /* start*/
-                               MAX_HEAP_SIZE,                               /* length */
+                               MAX_HEAP_SIZE + huge_page_size,              /* length */
                                PROT_READ | PROT_WRITE,                      /* permissions */
                                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, /* flags */
                                -1,                                          /* fd */
@@ -136,15 +596,20 @@ void mem_init(){
 	fprintf(stderr, "FAILURE.  mmap couldn't allocate space for heap\n");
 	exit(1);
     }
+    addr = align_mapping(addr, MAX_HEAP_SIZE, huge_page_size);
     heap = addr;
     mem_max_addr = addr + MAX_HEAP_SIZE;
     mem_reset_brk();
+    for (int i = 0; i < MM_MAX_REGIONS; i++) {
+	region_clean[i] = heap + (size_t) i * REGION_SIZE;
+    }
 }
 
 /* 
  * mem_deinit - free the storage used by the memory system model
  */
 void mem_deinit(void){
+    unmap_all();
     if (munmap(heap, MAX_HEAP_SIZE) != 0) {
         fprintf(stderr, "FAILURE.  munmap couldn't deallocate heap space\n");
         exit(1);
@@ -152,10 +617,114 @@ void mem_deinit(void){
 }
 
 /*
- * mem_reset_brk - reset the simulated brk pointer to make an empty heap
+ * mem_reset_brk - reset the simulated brk pointer to make an empty heap,
+ *           without mappings
  */
 void mem_reset_brk(){
+    unmap_all();
     mem_brk = heap;
+    for (int i = 1; i < MM_MAX_REGIONS; i++) {
+        region_brk[i] = heap + (size_t) i * REGION_SIZE;
+    }
+}
+
+/*
+ * mem_reset_heap - reset the heap as mem_reset_brk does, and give back
+ *           every page written since mem_init, so that the empty heap
+ *           reads zero as a new one does
+ */
+void mem_reset_heap(){
+    for (int i = 0; i < MM_MAX_REGIONS; i++) {
+	shrink_break(&region_clean[i], heap + (size_t) i * REGION_SIZE, region_clean[i]);
+    }
+    mem_reset_brk();
+}
+
+/*
+ * resident_bytes - returns the number of bytes of the pages from lo,
+ *           a page boundary, to hi held in physical memory
+ */
+static size_t resident_bytes(unsigned char *lo, unsigned char *hi) {
+    static unsigned char vec[RESIDENT_CHUNK_PAGES];
+    size_t page = (size_t) getpagesize();
+    size_t pages = ((size_t) (hi - lo) + page - 1) / page;
+    size_t resident = 0;
+
+    while (pages > 0) {
+	size_t n = pages < RESIDENT_CHUNK_PAGES ? pages : RESIDENT_CHUNK_PAGES;
+	if (mincore(lo, n * page, vec) != 0)
+	    break;
+	for (size_t i = 0; i < n; i++)
+	    resident += (vec[i] & 1) * page;
+	lo += n * page;
+	pages -= n;
+    }
+    return resident;
+}
+
+/*
+ * mem_resident - returns the number of bytes of the heap, of the
+ *           regions up to their breaks and of the mappings held in
+ *           physical memory
+ */
+size_t mem_resident(void) {
+    size_t resident = 0;
+
+    for (int r = 0; r < MM_MAX_REGIONS; r++) {
+	unsigned char *lo = heap + (size_t) r * REGION_SIZE;
+	resident += resident_bytes(lo, r == 0 ? mem_brk : region_brk[r]);
+    }
+    for (mapping_t *m = mappings; m != NULL; m = m->next)
+	resident += resident_bytes(m->addr, m->addr + m->size);
+    return resident;
+}
+
+/*
+ * mem_mapped - returns the total size of the mappings made by mm_map
+ */
+size_t mem_mapped(void) {
+    return mapped_bytes;
+}
+
+/*
+ * mem_huge_resident - returns the number of bytes of the reserved space
+ *           and of the mappings backed by transparent huge pages, as
+ *           /proc/self/smaps reports them
+ */
+size_t mem_huge_resident(void) {
+    FILE *fp = fopen("/proc/self/smaps", "r");
+    char line[256];
+    bool ours = false;
+    size_t huge = 0;
+
+    if (fp == NULL)
+	return 0;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+	uintptr_t lo, hi;
+	size_t kb;
+	if (sscanf(line, "%lx-%lx ", &lo, &hi) == 2) {
+	    /* a new area: ours if it lies in the reserved space or in a mapping */
+	    ours = (lo >= (uintptr_t) heap && hi <= (uintptr_t) mem_max_addr) ||
+		mem_in_mapping((void *) lo, (void *) (hi - 1));
+	} else if (ours && sscanf(line, "AnonHugePages: %zu kB", &kb) == 1) {
+	    huge += kb * 1024;
+	}
+    }
+    fclose(fp);
+    return huge;
+}
+
+/*
+ * mem_in_mapping - returns whether the bytes from lo to hi lie in a
+ *           single mapping made by mm_map
+ */
+bool mem_in_mapping(const void *lo, const void *hi) {
+    for (mapping_t *m = mappings; m != NULL; m = m->next) {
+	if ((const unsigned char *) lo >= m->addr &&
+	    (const unsigned char *) hi < m->addr + m->size)
+	    return true;
+    }
+    return false;
 }
 
 void *mem_sbrk(intptr_t incr) {
@@ -9,8 +9,23 @@ void *mm_heap_lo(void);
 void *mm_heap_hi(void);
 size_t mm_heapsize(void);
 size_t mm_pagesize(void);
+size_t mm_hugepagesize(void);
+int mm_advise_huge(bool enable);
 void *mm_memcpy(void *dst, const void *src, size_t n);
 void *mm_memset(void *dst, int c, size_t n);
+int mm_purge(void *addr, size_t len);
+bool mm_known_zero(const void *addr);
+
+/* Mappings outside the heap, for huge blocks */
+void *mm_map(size_t size);
+int mm_unmap(void *addr);
+void *mm_remap(void *addr, size_t size, bool may_move);
+
+/* Regions of the reserved space, each with its own break (for arenas) */
+#define MM_MAX_REGIONS 16
+
+void *mm_region_sbrk(int region, intptr_t incr);
+int mm_region_of(const void *ptr);
 
 /* Functions used for memory emulation */
 /* You should not be calling these functions */
@@ -19,10 +34,15 @@ void mem_init();
 void mem_deinit(void);
 void *mem_sbrk(intptr_t incr);
 void mem_reset_brk(void); 
+void mem_reset_heap(void);
 void *mem_heap_lo(void);
 void *mem_heap_hi(void);
 size_t mem_heapsize(void);
 size_t mem_pagesize(void);
+size_t mem_resident(void);
+size_t mem_mapped(void);
+size_t mem_huge_resident(void);
+bool mem_in_mapping(const void *lo, const void *hi);
 
 /* Read len bytes and return value zero-extended to 64 bits */
 /* Require 0 <= len <= 8 */
@@ -7,26 +7,119 @@
  *
  * DESIGN: 
  * 
- * Malloc implementation using segregated free lists and first fit allocation strategy. 
+ * Malloc implementation using a two-level segregated fit (TLSF) index over explicit free lists. 
  * 
- * Segregated list contains explicit free list of 14 lists, 
- * each containing free blocks of size 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768, 65536 and greater than 65536 bytes.
- * The free list is a circular doubly linked list with a head pointer.
+ * Free blocks up to 65536 bytes are indexed by a first level (power of two size class) and a second level 
+ * (8 linear subclasses of each power of two). Blocks below 128 bytes are indexed linearly in 16 byte steps.
+ * Each class is a circular doubly linked list with a head pointer.
+ * 
+ * Free blocks greater than 65536 bytes form the unbounded top class, kept in a splay tree keyed by (size, address) 
+ * whose left and right child pointers are stored in the free blocks themselves. Large requests take the smallest 
+ * fitting block, lowest address first, in amortized O(log n).
+ * 
+ * A first level bitmap records which first level classes are non-empty and a second level bitmap per first level class
+ * records which subclasses are non-empty, so finding a non-empty class large enough for a request is a ctz on the bitmaps.
+ * The list heads and bitmaps live in a control block at the start of the heap.
+ * Each subclass also keeps an upper bound on the size of its blocks, raised on insert and lowered to the exact largest
+ * size by a scan that finds no fit, so a request larger than every block of its subclass skips the scan of the list.
  * 
  * Each free block contains a header and a footer, each of size 8 bytes.
- * The header contains the size of the block, the current allocated bit and the previous allocated bit.
- * The footer contains the size of the block and the current allocated bit.
+ * The header contains the size of the block, the current allocated bit, the previous allocated bit, the quick bit
+ * and the previous mini bit. The footer contains the size of the block and the current allocated bit.
+ * A footer and the next header lie in the 16 bytes below the next payload, so they always share a cache line: freeing
+ * a block reads the previous footer from the line of its own header and writes its footer to the line of the next header,
+ * which it updates anyway, so the boundary tags add no cache line to the free path.
+ * 
+ * Mini blocks of 16 bytes hold a header and a payload of up to 8 bytes. A free mini block has no room for a footer 
+ * or two pointers, so the doubly linked mini list links it by two 32-bit offsets from the heap control block in 16 byte 
+ * units, and coalescing unlinks it in constant time. A mini block past 64 GiB from the control block stays off the list 
+ * until it coalesces. The block after a free mini block has its previous mini bit set, which tells coalescing where 
+ * the mini block starts. Mini blocks are the leftovers of splits and 
+ * alignment gaps that used to stay in the allocated block, and requests of up to 8 bytes reuse them before the slab pages.
+ * 
+ * Built with -DMM_COMPACT, headers and footers take 4 bytes, the size in 16 byte granules above the same flag bits, 
+ * and the free list links are 32-bit offsets from the heap control block in 16 byte units, so a free list node takes 
+ * 8 bytes and shares its 16 byte granule with the header. Blocks cost 4 bytes of overhead and mini blocks hold 12 bytes.
+ * Every block size has to fit the header, so a heap stays below 4 GiB. Mapped blocks keep their size in the padding.
+ * 
+ * The prologue (16 bytes) and epilogue (8 bytes, 4 compact) blocks are used to mark the start and end of the heap.
+ * Padding (8 bytes, 12 compact) is used to ensure that the payload is 16-byte aligned.
+ * 
+ * Requests of up to 256 bytes are served by a slab (big bag of pages) front end instead. A slab page is an allocated 
+ * block of 4096 bytes whose payload is 4096-byte aligned, split into equal slots of one of 16 size classes (16 to 256 bytes). 
+ * A descriptor at the start of the page holds the slot size and the free slot list, so the slots carry no header.
+ * The free function finds the page of a pointer by rounding it down to the page alignment, and tells a slab page from 
+ * the payload of a block spanning it by its bit in the slab page map of the heap, a bitmap by page index that lives in 
+ * an allocated block of its own, so the contents of a payload never make a page pass for a slab page.
+ * Each class keeps a list of its pages with free slots, and a page is freed back to the heap once it is empty, 
+ * unless it is the last partial page of its class. Slab blocks take exactly 4096 bytes, since the header of the next block 
+ * fills the last word of the page, so pages carved one after another from the wilderness need no alignment gap.
+ * While the heap is below two slab pages, requests only take slab slots once the live blocks of their size would fill a slab 
+ * page, and are served as blocks until then, so a heap with a few small blocks does not pay a page per class. Past that 
+ * size every small request takes slab slots. The thread caches of the threaded build hold 
+ * slab slots, so there small requests take slab slots from the start.
+ * 
+ * The malloc function first searches the size class of the request for a fitting block, then takes the head of the 
+ * next non-empty class found through the bitmaps, where every block is large enough (good fit).
+ * 
+ * The free function pushes blocks of up to 512 bytes onto exact size LIFO quick lists, without touching the boundary tags 
+ * or coalescing. Quick blocks stay marked allocated, with an extra quick bit in the header, and malloc pops them first. 
+ * They are consolidated (freed and coalesced for real) when no free block fits a request or the quick lists exceed 64 KiB.
+ * Larger blocks are freed right away, and coalesced with the adjacent free blocks if possible.
  * 
- * The prologue (16 bytes) and epilogue (8 bytes) blocks are used to mark the start and end of the heap.
- * Padding (8 bytes) is used to ensure that the payload is 16-byte aligned.
+ * The realloc function resizes blocks in place where possible. A shrink splits off the tail and coalesces it with a free next block.
+ * A growth first absorbs a free next block, and at the end of the heap expands the heap by just the missing bytes.
+ * Otherwise it merges with a free previous block and moves the payload down with memmove. 
+ * Only if all of these fail it allocates a new block and copies the old block to the new block.
  * 
- * The malloc function uses the best fit strategy to find a free block of sufficient size.
+ * The calloc function allocates a block of nmemb * size bytes and sets the block to zero. Free blocks carry a zero bit 
+ * in their footer when their payload is known to be zero past the free list node: memory past every earlier break, 
+ * and purged interiors whose partial end pages were cleared. Splits keep the bit on the remainder, 
+ * so calloc only clears the node and a stale footer of such blocks, and nothing of a mapping.
  * 
- * The free function coalesces the current free block with the adjacent free block if possible.
+ * Requests above 1 MiB bypass the heap and get a page-rounded mapping of their own, whose padding word holds the mapping size 
+ * and whose header a mapped bit (the quick bit, which no handed-out block has). Freeing such a block unmaps it at once, and realloc 
+ * resizes it with mremap, so huge blocks never fragment the heap and are never copied while they stay above 1 MiB.
  * 
- * The realloc function allocates a new block of size size and copies the old block to the new block if the new size is greater than the old size.
+ * Memory is given back to the system as it decays. Bytes freed into blocks above 65536 bytes count as dirty, 
+ * and the bytes made dirty in each of the last 16 epochs of the decay time (MM_DECAY_MS, 10 s by default) may stay dirty 
+ * in a proportion that falls along a smoothstep curve as they age. Past that limit, the wilderness is trimmed down 
+ * to 64 KiB by shrinking the heap, and then the page-aligned interiors of the large free blocks are purged, oldest first, 
+ * and the purged bit in their footer set. The large free blocks not visited since they were last split or coalesced 
+ * are kept on a list, so a purge never walks the blocks it gave back before. MM_DECAY_MS=0 gives the memory back at once, and a negative value never.
  * 
- * The calloc function allocates a block of nmemb * size bytes and sets the block to zero.
+ * With MM_HUGEPAGES=1, the reserved space and the mappings are advised as eligible for transparent huge pages, 
+ * whose boundaries the start of the heap and of each region fall on. The heap then grows and is trimmed so that it 
+ * ends on a huge page boundary, and only whole huge pages of the large free blocks are purged, so no huge page 
+ * is split into small pages or left partly used at the end of the heap.
+ * 
+ * With MM_COLORING=1, requests of 4096 bytes or more are colored: their payloads start at one of 16 offsets, a cache line 
+ * apart, modulo 4096, taken in turn. Blocks carved in a row then map to different cache sets instead of all starting 
+ * at the same page offset. The block is placed like an aligned block, and the gap in front is freed for smaller requests.
+ * Aligned requests below 4096 bytes are colored in steps of their alignment.
+ * 
+ * The malloc_usable_size function reports the real capacity of a block (its slot size, or its block size less the header), 
+ * and good_size the capacity a request will get. The try_expand function grows a block in place only, into a free next 
+ * block or past the end of the heap, and never moves it, so containers can use their slack and skip copying reallocations.
+ * 
+ * The free_sized function takes the size the block was requested with. A block above 256 bytes cannot be a slab slot 
+ * and its block size is exactly the aligned request, so it is freed without probing for a slab page or decoding 
+ * the size in its header (checked against the header in debug builds).
+ * 
+ * The memalign, aligned_alloc and posix_memalign functions allocate blocks whose payload is aligned to a power of two. 
+ * They first scan the class of the request for a free block whose payload is aligned or close enough to the alignment 
+ * that the block still fits past the gap, and only then take a block large enough for any gap. The leading gap 
+ * is freed as a block (or mini block) of its own and the trailing remainder is split off, so no byte is lost to padding.
+ * 
+ * The malloc_batch function allocates n blocks of one size at once. Slab sizes take the slots of each page in one pass. 
+ * Larger sizes first reuse the blocks of their quick list, then carve all the remaining blocks out of a single fit, 
+ * writing their headers in one loop, with one free list update for the whole run. The free_batch function sorts its 
+ * pointers by address and frees each run of adjacent blocks as one block, coalesced and inserted once.
+ * 
+ * Built with -DMM_THREADS, the allocator is thread-safe: the memory is split into arenas, each a complete heap with its 
+ * own control block and lock in its own region of the reserved space, and threads are spread over the arenas. 
+ * Each thread also caches free slab slots per class (tcache), so most small malloc and free calls run without a lock 
+ * or atomic operation. The default build has a single heap, no lock and no cache.
  * 
  * -----------------------------------------------------------------------------------------------------------------------------------------------
  * 
@@ -34,11 +127,17 @@
  * 
  * a: bit signifying if the block is allocated
  * 
+ * m: bit signifying if the previous block is a free mini block
+ * 
  * p: bit signifying if the previous block is allocated
  * 
  * The following is an ASCII diagram of the heap:
  * 
  *                        p   a
+    +--------------------+-+-+-+
+    |    heap control block:   | Prologue and epilogue pointers,
+    |                          | free list heads and bitmaps
+    |      (heap_ctl_t)        |
     +--------------------+-+-+-+
     |    padding:        |0|0|0| Padding
     +--------------------+-+-+-+
@@ -66,7 +165,9 @@
     |    size:           |0|x|0| Header
     +--------------------+-+-+-+
     |    free_list_node_t:     | pointer for linking free list
-    |      prev, next          |
+    |      prev, next          | (free_tree_node_t: left, right,
+    |                          |  prev_dirty, next_dirty
+    |                          |  for blocks above 65536 bytes)
     +--------------------------+
     |                          |
     |      :                   |
@@ -74,20 +175,20 @@
     |    payload               |
     |      :                   |
     |      :                   |
-    |                          |
-    +--------------------------+
-    |    size:                 | Footer
-    +--------------------------+
+    |                          | (page-aligned interior given
+    +--------------------+-+-+-+  back once purged)
+    |    size:           |u|0|0| Footer (u: purged)
+    +--------------------+-+-+-+
  * 
  * 
  * The following is an ASCII diagram of the allocated block:
  * 
  *                        p   a
     +--------------------+-+-+-+
-    |    size:           |0|x|0| Header
+    |    size:           |q|x|1| Header (q: in a quick list)
     +--------------------+-+-+-+
-    |                          |
-    |                          |
+    |                          | (quick_list_node_t: next,
+    |                          |  for blocks in a quick list)
     |      :                   |
     |      :                   |
     |    payload               |
@@ -96,13 +197,55 @@
     |                          |
     +--------------------------+
  * 
+ * 
+ * The following is an ASCII diagram of the free mini block, followed by the next block:
+ * 
+ *                      m q p a
+    +------------------+-+-+-+-+
+    |    size: 16      |x|0|x|0| Header
+    +------------------+-+-+-+-+
+    |prev link   |next link    |
+    +------------------+-+-+-+-+
+    |    size:         |1|x|0|x| Header of the next block
+    +------------------+-+-+-+-+
+ * 
+ * 
+ * The following is an ASCII diagram of the slab page, an allocated block with a 4096-byte aligned payload:
+ * 
+ *                        p   a
+    +--------------------+-+-+-+
+    |    size: 4096      |0|x|1| Header
+    +--------------------+-+-+-+ <- 4096-byte boundary
+    |    slab_page_t:          | partial page links,
+    |                          | free slot list, slot size, counts
+    +--------------------------+
+    |    slot                  | (slab_slot_t: next, for free slots)
+    +--------------------------+
+    |      :                   |
+    +--------------------------+
+    |    slot                  |
+    +--------------------------+
+    |    unused                |
+    +--------------------+-+-+-+
+    |    size:           |x|x|x| Header of the next block
+    +--------------------+-+-+-+ <- 4096-byte boundary
+ * 
  * -----------------------------------------------------------------------------------------------------------------------------------------------
  * 
- * GLOBAL VARIABLE SPACE (128 bytes):
+ * GLOBAL VARIABLE SPACE (25 bytes):
+ * 
+ * Heap control block pointer: 8 bytes
+ * Decay time: 8 bytes
+ * Huge page size: 8 bytes
+ * Cache coloring switch: 1 byte
  * 
- * Prologue pointer: 8 bytes
- * Epilogue pointer: 8 bytes
- * Free list: 14 * 8 bytes = 112 bytes
+ * The prologue and epilogue pointers, free list heads (11 * 8 + 1 lists), bitmaps, quick lists, mini list, 
+ * slab page lists and decay backlog are stored in the heap control block.
+ * 
+ * The -DMM_THREADS build adds the arena table (16 * 8 bytes), the arena creation lock (40 bytes), 
+ * the round robin counter, remote free switch, tcache key and its once flag (16 bytes), the maintenance thread 
+ * with its lock, condition, flags and async free queue (112 bytes), and per thread a thread local cache, arena index 
+ * and heap control block pointer, and the mapping lock (40 bytes).
  * 
  * -----------------------------------------------------------------------------------------------------------------------------------------------
  * 
@@ -120,6 +263,17 @@
  * 7. The next block pointer in consistent
  * 8. The prev block pointer in consistent
  * 9. The free block is in correct free list
+ * 10. The first and second level bitmaps match the non-empty free lists
+ * 11. The large block tree is ordered by (size, address) and holds exactly the large free blocks
+ * 12. The quick lists hold exactly the blocks with the quick bit, each in the list of its size
+ * 13. The previous mini bit of every block after a free block tells if that block is a mini block
+ * 14. The mini list holds exactly the free mini blocks
+ * 15. The slab pages are aligned blocks whose slot counts add up, the partial page lists hold exactly the non-full pages,
+ *     and the slab page map marks exactly the slab pages
+ * 16. Only the free blocks of the large block tree are marked purged
+ * 17. A free block marked zero reads zero past its free list node up to its footer
+ * 18. No block of a free list is larger than the size bound of the list
+ * 19. The dirty block list holds only blocks of the large block tree not marked purged, with consistent links
  * 
  * -----------------------------------------------------------------------------------------------------------------------------------------------
  *
@@ -131,12 +285,19 @@
  */
 
 #include <assert.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <time.h>
+
+#ifdef MM_THREADS
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 #include "mm.h"
 #include "memlib.h"
@@ -165,21 +326,92 @@
 #define free mm_free
 #define realloc mm_realloc
 #define calloc mm_calloc
+#define malloc_batch mm_malloc_batch
+#define free_batch mm_free_batch
+#define free_sized mm_free_sized
+#define memalign mm_memalign
+#define aligned_alloc mm_aligned_alloc
+#define posix_memalign mm_posix_memalign
+#define malloc_usable_size mm_malloc_usable_size
+#define good_size mm_good_size
+#define try_expand mm_try_expand
 #define memset mm_memset
 #define memcpy mm_memcpy
 #endif // DRIVER
 
 #define ALIGNMENT 16
 
+#ifdef MM_COMPACT
+#define PADDING_SIZE 12
+#define HEADER_SIZE 4
+#define FOOTER_SIZE 4
+#define PROLOGUE_SIZE 16
+#define EPILOGUE_SIZE 4
+#define MAX_ARENA_SIZE 4294967296   // a heap stays below 4 GiB, so every block size fits a 4 byte header
+#else
 #define PADDING_SIZE 8
 #define HEADER_SIZE 8
 #define FOOTER_SIZE 8
 #define PROLOGUE_SIZE 16
 #define EPILOGUE_SIZE 8
+#endif
 #define UINT64_T_SIZE 8 
 
-uint64_t* prologue_ptr; 
-uint64_t* epilogue_ptr;
+#define SL_INDEX_COUNT_LOG2 3       // 8 second level subclasses per first level class
+#define SL_INDEX_COUNT 8
+#define FL_INDEX_SHIFT 7            // log2 of SMALL_BLOCK_SIZE
+#define SMALL_BLOCK_SIZE 128        // blocks below this size are indexed linearly
+#define LARGE_BLOCK_SIZE 65536      // blocks above this size go to the top class
+#define FL_INDEX_COUNT 11
+#define FREE_LIST_COUNT 88          // FL_INDEX_COUNT * SL_INDEX_COUNT
+#define LARGE_LIST_INDEX 88         // index of the top class, kept in the large block tree
+
+#define QUICK_BIT 0x4                 // header bit of blocks in a quick list
+#define PREV_MINI_BIT 0x8             // header bit set if the previous block is a free mini block
+#define MINI_BLOCK_SIZE 16            // a mini block holds a header and an 8 byte payload or two 4 byte links, and no footer
+#define MAX_MINI_LINK 4294967295      // largest offset of a mini list link, in units of ALIGNMENT from the heap control block
+#define MAX_QUICK_SIZE 512            // largest block size kept in the quick lists
+#define QUICK_LIST_OFFSET 2           // the smallest block size, 32 bytes, is quick list 0
+#define QUICK_LIST_COUNT 31           // one list per block size from 32 to 512 bytes
+#define QUICK_BYTES_THRESHOLD 65536   // the quick lists are consolidated above this many bytes
+
+#define INSERTION_SORT_LIMIT 16       // free_batch sorts up to this many pointers by insertion
+#define ALIGNED_FIT_SCAN_LIMIT 8      // free blocks of the class of an aligned request checked for a fit past their gap
+
+#define SLAB_PAGE_SIZE 4096           // size and alignment of a slab page, whose last word is the header of the next block
+#define SLAB_HEADER_SIZE 48           // space kept for the slab page descriptor, the slots follow it
+#define MAX_SLAB_SIZE 256             // largest request served from the slab pages
+#define SLAB_CLASS_COUNT 16           // one slab class per slot size from 16 to 256 bytes
+#define SLAB_MAP_MIN_PAGES 512        // pages covered by the first slab page map, 2 MiB of heap
+#define SLAB_WARM_BYTES SLAB_PAGE_SIZE   // live bytes in blocks of one size before requests of that size take slab slots
+#define SLAB_WARM_HEAP_SIZE (2 * SLAB_PAGE_SIZE)   // heap size from which every request up to MAX_SLAB_SIZE takes slab slots
+
+#define MIN_GROW_SIZE 64            // bounds of the heap growth chunk
+#define MAX_GROW_SIZE 262144
+#define GROW_SIZE_HEAP_RATIO 32     // the growth chunk is at most 1/32 of the heap
+#define GROW_WINDOW 64              // the heap grows fast if a chunk lasts fewer carves than this
+
+#define PURGED_BIT 0x4              // footer bit of a free block whose page-aligned interior has been purged
+#define ZERO_BIT 0x8                // footer bit of a free block whose payload is zero past its free list node
+#define TRIM_PAD 65536              // bytes of the wilderness kept when the heap is trimmed
+#define PURGE_BATCH_SIZE 65536      // dirty bytes above the decay limit that trigger a purge
+#define DECAY_MS 10000              // default time over which dirty pages are purged, MM_DECAY_MS overrides it
+#define DECAY_STEPS 16              // epochs of the decay curve
+
+#define MMAP_THRESHOLD 1048576      // requests above this size get a mapping of their own
+#define MAPPED_BIT 0x4              // header bit of a mapped block, the quick bit, which no block handed out carries otherwise
+
+#define COLOR_THRESHOLD 4096        // requests of at least this size are colored with MM_COLORING=1
+#define COLOR_PERIOD 4096           // colored payloads start at a rotating offset modulo this span of cache sets
+#define COLOR_STEP 64               // distance between two colors, a cache line
+#define COLOR_COUNT 16              // colors rotated through
+#define CACHE_MODEL_LINE 64         // line size of the data cache modeled with MM_CACHE_MODEL, for mdriver -M
+#define CACHE_MODEL_SETS 64         // sets of the modeled cache, 32 KiB in 8 ways
+#define CACHE_MODEL_WAYS 8          // lines per set, replaced in LRU order
+
+int64_t decay_ms;           // time over which dirty pages are purged, 0 to purge them at once, negative to never purge
+uint64_t huge_page_size;    // huge page size with MM_HUGEPAGES=1, which the heap grows, shrinks and is purged by, 0 otherwise
+bool cache_coloring;        // large blocks start at rotating offsets within a page, set by MM_COLORING=1
 
 // rounds up to the nearest multiple of ALIGNMENT
 static size_t align(size_t x)
@@ -189,11 +421,19 @@ static size_t align(size_t x)
 
 /*
  * structure of the free list which is a circular doubly linked list with head pointer
+ * -DMM_COMPACT stores the links as offsets from the heap control block in units of ALIGNMENT bytes, 0 for none
  */
+#ifdef MM_COMPACT
+typedef struct free_list_node {
+    uint32_t prev;
+    uint32_t next;
+} free_list_node_t;
+#else
 typedef struct free_list_node {
     struct free_list_node* prev;
     struct free_list_node* next;
 } free_list_node_t;
+#endif
 
 /*
  * structure of the free list head
@@ -202,10 +442,145 @@ typedef struct free_list {
     free_list_node_t* head;
 } free_list_t;
 
-free_list_t free_list[14];
+/*
+ * structure of the large block tree node, a splay tree keyed by (block size, block address)
+ */
+typedef struct free_tree_node {
+    struct free_tree_node* left;
+    struct free_tree_node* right;
+    struct free_tree_node* prev_dirty;    // links of the list of blocks that may have pages to purge, NULL off the list
+    struct free_tree_node* next_dirty;
+} free_tree_node_t;
+
+/*
+ * structure of the mini list node, a doubly linked list of the free 16 byte blocks
+ * the links are offsets from the heap control block in units of ALIGNMENT bytes, 0 for none, as in the -DMM_COMPACT free lists
+ */
+typedef struct mini_list_node {
+    uint32_t prev;
+    uint32_t next;
+} mini_list_node_t;
+
+/*
+ * structure of the quick list node, a singly linked LIFO list of blocks of one exact size
+ */
+typedef struct quick_list_node {
+    struct quick_list_node* next;
+} quick_list_node_t;
+
+/*
+ * structure of a free slab slot, a singly linked LIFO list of the free slots of one page
+ */
+typedef struct slab_slot {
+    struct slab_slot* next;
+} slab_slot_t;
+
+/*
+ * structure of the slab page descriptor, stored at the start of a SLAB_PAGE_SIZE aligned page
+ * slots never handed out yet lie from bump_offset to the end of the page and are not in the free slot list
+ */
+typedef struct slab_page {
+    struct slab_page* prev;     // neighbours in the partial page list of the class
+    struct slab_page* next;
+    slab_slot_t* free_slot;
+    uint32_t slot_size;
+    uint16_t used_count;
+    uint16_t bump_offset;
+} slab_page_t;
+
+/*
+ * structure of the heap control block, stored at the start of the heap, which holds the whole state of a heap (arena)
+ * free_list[fl * SL_INDEX_COUNT + sl] is the list of second level subclass sl of first level class fl
+ * bit fl of fl_bitmap is set iff sl_bitmap[fl] != 0, bit sl of sl_bitmap[fl] is set iff the list is non-empty
+ * list_max[i] bounds the size of the blocks of the non-empty list i, in units of ALIGNMENT, and is stale for an empty list
+ */
+typedef struct heap_ctl {
+    uint64_t* prologue_ptr;
+    uint64_t* epilogue_ptr;
+    int region;                 // region of the reserved space the heap grows in
+#ifdef MM_THREADS
+    pthread_mutex_t lock;
+    void* remote_free;          // lock-free stack of blocks freed by threads of other arenas
+#endif
+    uint32_t fl_bitmap;
+    uint8_t sl_bitmap[FL_INDEX_COUNT];
+    free_list_t free_list[FREE_LIST_COUNT];
+    uint16_t list_max[FREE_LIST_COUNT];
+    free_tree_node_t* large_tree;
+    free_tree_node_t* dirty_blocks;   // circular list of the large free blocks that may have pages to purge, newest first
+    uint64_t* wilderness;       // free block at the end of the heap, in no free list, NULL if the last block is allocated
+    uint64_t grow_size;         // current heap growth chunk
+    uint64_t carve_count;       // allocations carved from the wilderness since the last heap expansion
+    quick_list_node_t* quick_list[QUICK_LIST_COUNT];
+    uint64_t quick_bytes;       // total size of the blocks in the quick lists
+    mini_list_node_t* mini_list;
+    slab_page_t* slab_partial[SLAB_CLASS_COUNT];   // pages of each slab class with a free slot
+    uint64_t slab_page_count;   // number of slab pages, partial or full
+    uint64_t* slab_map;         // payload of the slab page map block, slab_map[0] pages covered, then one bit per page
+    uint16_t slab_warm;         // bit i set once requests of block size (i + 2) * ALIGNMENT take slab slots
+    uint8_t slab_live[SLAB_CLASS_COUNT];   // live blocks of each of these block sizes until then
+    uint64_t dirty_bytes;       // bytes freed into large free blocks and not purged since
+    uint64_t decay_epoch;       // start of the current decay epoch, in ns
+    uint64_t decay_backlog[DECAY_STEPS];   // bytes made dirty in each of the last epochs, newest first
+    uint64_t next_color;        // color of the next colored block
+#ifdef MM_FIT_STATS
+    uint64_t fit_node_count;    // free list nodes visited by the fit scans, for mdriver -S
+#endif
+#ifdef MM_CACHE_MODEL
+    uint64_t cache_tags[CACHE_MODEL_SETS][CACHE_MODEL_WAYS];   // lines held by each set of the modeled cache, most recent first
+    uint64_t cache_access_count;   // metadata accesses fed to the modeled cache, for mdriver -M
+    uint64_t cache_miss_count;     // those that missed it
+#endif
+} heap_ctl_t;
+
+#ifdef MM_THREADS
+#define ARENA_COUNT MM_MAX_REGIONS  // one arena per region of the reserved space
+
+static __thread heap_ctl_t* heap_ctl;     // arena locked by the thread
+heap_ctl_t* arenas[ARENA_COUNT];          // NULL until the arena is created
+pthread_mutex_t map_lock = PTHREAD_MUTEX_INITIALIZER;   // serializes the mappings of mapped blocks
+#else
+heap_ctl_t* heap_ctl;
+#endif
+
+/**
+ * @brief feeds a metadata access to the cache modeled with MM_CACHE_MODEL, a CACHE_MODEL_WAYS-way LRU cache, 
+ * and counts it as a miss if its line is not held, does nothing in other builds
+ * 
+ * @param ptr: address of the header, footer or link accessed
+ * 
+ * @return void
+ */
+static void model_cache_access(const void *ptr) {
+
+#if defined(MM_CACHE_MODEL) && !defined(MM_THREADS)
+    if (heap_ctl == NULL) {
+        return;
+    }
+
+    uint64_t line = (uint64_t)ptr / CACHE_MODEL_LINE;
+    uint64_t* set = heap_ctl->cache_tags[line % CACHE_MODEL_SETS];
+    int way = 0;
+
+    heap_ctl->cache_access_count++;
+    while (way < CACHE_MODEL_WAYS - 1 && set[way] != line) {
+        way++;
+    }
+    if (set[way] != line) {
+        heap_ctl->cache_miss_count++;
+    }
+
+    //the line moves to the front of its set, a missed line evicts the least recently used one
+    for (; way > 0; way--) {
+        set[way] = set[way - 1];
+    }
+    set[0] = line;
+#endif
+
+}
 
 /**
- * @brief reads a word at address ptr
+ * @brief reads a word at address ptr, a header or footer of HEADER_SIZE bytes
  * 
  * @param ptr: address of the word
  * 
@@ -213,12 +588,18 @@ free_list_t free_list[14];
  */
 static uint64_t read_block(uint64_t *ptr) {
 
+    model_cache_access(ptr);
+
+#ifdef MM_COMPACT
+    return *((uint32_t *)ptr);
+#else
     return *((uint64_t *)ptr);
+#endif
 
 }
 
 /**
- * @brief writes a word at address ptr
+ * @brief writes a word at address ptr, a header or footer of HEADER_SIZE bytes
  * 
  * @param ptr: address of the word
  * @param val: value to be written
@@ -227,7 +608,12 @@ static uint64_t read_block(uint64_t *ptr) {
  */
 static void write_block(uint64_t *ptr, uint64_t val) {
 
+    model_cache_access(ptr);
+#ifdef MM_COMPACT
+    *((uint32_t *)ptr) = (uint32_t)val;
+#else
     *((uint64_t *)ptr) = val;
+#endif
 
 }
 
@@ -268,7 +654,7 @@ static uint64_t packFooter(uint64_t size, uint64_t is_allocated) {
  */
 static uint64_t get_block_size(uint64_t *ptr) {
 
-    return read_block(ptr) & ~0x7;
+    return read_block(ptr) & ~0xF;
 
 }
 
@@ -299,6 +685,48 @@ static uint64_t get_is_prev_allocated(uint64_t *ptr) {
 }
 
 
+/**
+ * @brief updates the previous allocated bit of a header, keeping its other bits
+ * 
+ * @param ptr: address of the block
+ * @param is_prev_allocated: previous allocated bit
+ * 
+ * @return void
+ */
+static void set_prev_allocated(uint64_t *ptr, uint64_t is_prev_allocated) {
+
+    write_block(ptr, (read_block(ptr) & ~(uint64_t)0x2) | is_prev_allocated << 1);
+
+}
+
+/**
+ * @brief rewrites the size and allocated bit of a header, keeping its previous allocated and previous mini bits
+ * 
+ * @param ptr: address of the block
+ * @param size: size of the block
+ * @param is_allocated: current allocated bit
+ * 
+ * @return void
+ */
+static void write_header(uint64_t *ptr, uint64_t size, uint64_t is_allocated) {
+
+    write_block(ptr, size | is_allocated | (read_block(ptr) & (0x2 | PREV_MINI_BIT)));
+
+}
+
+/**
+ * @brief reads if the block is in a quick list from header
+ * 
+ * @param ptr: address of the block
+ * 
+ * @return uint64_t: the quick bit of the block
+ */
+static uint64_t get_is_quick(uint64_t *ptr) {
+
+    return (read_block(ptr) & QUICK_BIT) >> 2;
+
+}
+
 /**
  * @brief returns the header address of a block, given block payload pointer
  * 
@@ -308,7 +736,7 @@ static uint64_t get_is_prev_allocated(uint64_t *ptr) {
  */
 static uint64_t* get_header(uint64_t *ptr) {
 
-    return (uint64_t *)((uint64_t *)ptr - (HEADER_SIZE/UINT64_T_SIZE));
+    return (uint64_t *)((char *)ptr - HEADER_SIZE);
 
 }
 
@@ -321,7 +749,7 @@ static uint64_t* get_header(uint64_t *ptr) {
  */
 static uint64_t* get_footer(uint64_t *ptr) {
 
-    return (uint64_t *)((uint64_t *)ptr + ((get_block_size(ptr) - FOOTER_SIZE)/UINT64_T_SIZE));
+    return (uint64_t *)((char *)ptr + get_block_size(ptr) - FOOTER_SIZE);
 
 }
 
@@ -347,7 +775,12 @@ static uint64_t* get_next_block(uint64_t *ptr) {
  */
 static uint64_t* get_prev_block(uint64_t *ptr) {
 
-    return ptr - (get_block_size(ptr - ((FOOTER_SIZE)/UINT64_T_SIZE))/UINT64_T_SIZE);
+    // a free mini block has no footer
+    if (read_block(ptr) & PREV_MINI_BIT) {
+        return ptr - (MINI_BLOCK_SIZE/UINT64_T_SIZE);
+    }
+
+    return ptr - (get_block_size((uint64_t *)((char *)ptr - FOOTER_SIZE))/UINT64_T_SIZE);
 
 }
 
@@ -360,7 +793,7 @@ static uint64_t* get_prev_block(uint64_t *ptr) {
  */
 static uint64_t* get_block_payload(uint64_t *ptr) {
 
-    return (uint64_t *)((uint64_t *)ptr + (HEADER_SIZE/UINT64_T_SIZE));
+    return (uint64_t *)((char *)ptr + HEADER_SIZE);
 
 }
 
@@ -369,535 +802,3833 @@ static uint64_t* get_block_payload(uint64_t *ptr) {
  * 
  * @param size: size of the block
  * 
- * @return int: the index of the free list
+ * @return int: the index of the free list, fl * SL_INDEX_COUNT + sl
  */
 static int get_list_index(uint64_t size) {
 
-    int index = 0; 
+    // blocks below SMALL_BLOCK_SIZE are indexed linearly in the first level class 0
+    if (size < SMALL_BLOCK_SIZE) {
+        return (int)(size / ALIGNMENT);
+    }
 
-    if(size < 17){
-        index = 0;
-    } 
-    if(size < 33) {
-        index = 1;
-    } 
-    else if(size < 65) {
-        index = 2;
-    } 
-    else if(size < 129) {
-        index = 3;
-    } 
-    else if(size < 257) {
-        index = 4;
-    } 
-    else if(size < 513) {
-        index = 5;
-    } 
-    else if(size < 1025) {
-        index = 6;
-    } 
-    else if(size < 2049) {
-        index = 7;
-    } 
-    else if(size < 4097) {
-        index = 8;
-    } 
-    else if(size < 8193) {
-        index = 9;
-    } 
-    else if(size < 16385) {
-        index = 10;
-    } 
-    else if(size < 32769) {
-        index = 11;
-    } 
-    else if(size < 65537) {
-        index = 12;
-    } 
-    else {
-        index = 13;
+    if (size > LARGE_BLOCK_SIZE) {
+        return LARGE_LIST_INDEX;
     }
 
-    return index;
+    // the first level is the most significant bit, the second level the next SL_INDEX_COUNT_LOG2 bits
+    int msb = 63 - __builtin_clzll(size);
+    int fl = msb - FL_INDEX_SHIFT + 1;
+    int sl = (int)((size >> (msb - SL_INDEX_COUNT_LOG2)) ^ SL_INDEX_COUNT);
+
+    return fl * SL_INDEX_COUNT + sl;
 
 }
 
 /**
- * @brief inserts a free block into the free list
+ * @brief: returns the index of the first non-empty free list whose blocks are all at least size bytes
  * 
- * @param free_block: free block to be inserted
- * @param index: index of the free list
+ * @param size: size of the block
  * 
- * @return void
+ * @return int: the index of the free list, or -1 if there is no such list
  */
-static void __attribute__ ((noinline)) insert_free_block(free_list_node_t* free_block, int index) {
+static int find_suitable_index(uint64_t size) {
+
+    // round the size up to the next subclass boundary so that every block of the subclass fits
+    if (size >= SMALL_BLOCK_SIZE && size <= LARGE_BLOCK_SIZE) {
+        int msb = 63 - __builtin_clzll(size);
+        size += ((uint64_t)1 << (msb - SL_INDEX_COUNT_LOG2)) - 1;
+        // the last subclass only holds blocks of exactly LARGE_BLOCK_SIZE bytes
+        if (size > LARGE_BLOCK_SIZE) {
+            size = LARGE_BLOCK_SIZE;
+        }
+    }
 
-    //if the free list is empty
-    if (free_list[index].head == NULL) {
-        free_list[index].head = free_block;
-        free_block->next = free_block;
-        free_block->prev = free_block;
-    } 
-    // if the free list is not empty
-    else {
-        free_block->next = free_list[index].head;
-        free_block->prev = free_list[index].head->prev;
-        free_list[index].head->prev->next = free_block;
-        free_list[index].head->prev = free_block;
+    int index = get_list_index(size);
+    if (index == LARGE_LIST_INDEX) {
+        return -1;
     }
 
-}
+    int fl = index / SL_INDEX_COUNT;
+    int sl = index % SL_INDEX_COUNT;
 
-/**
- * @brief: removes a free block from the free list
- * 
- * @param free_block: free block to be removed
- * @param index: index of the free list
- * 
- * @return void
- */
-static void __attribute__ ((noinline)) remove_free_block(free_list_node_t* free_block, int index) {
+    // search the remaining subclasses of the same first level class
+    uint32_t sl_map = heap_ctl->sl_bitmap[fl] & (~0u << sl);
 
-    // If the free block is the head of the free list
-    if (free_block == free_list[index].head) {
-        // if free block is the only block in the free list
-        if (free_block->next == free_block) {
-            free_list[index].head->next = NULL;
-            free_list[index].head->prev = NULL;
-            free_list[index].head = NULL;
-            return;
-        } else {
-            free_list[index].head = free_block->next;
+    if (sl_map == 0) {
+        // search the larger first level classes
+        uint32_t fl_map = heap_ctl->fl_bitmap & (~0u << (fl + 1));
+        if (fl_map == 0) {
+            return -1;
         }
+        fl = __builtin_ctz(fl_map);
+        sl_map = heap_ctl->sl_bitmap[fl];
     }
-    // if the free block is not the head of the free list
-    free_block->prev->next = free_block->next;
-    free_block->next->prev = free_block->prev;
-    free_block->next = NULL;
-    free_block->prev = NULL;
 
-    return; 
+    return fl * SL_INDEX_COUNT + __builtin_ctz(sl_map);
 
 }
 
 /**
- * @brief coalesces the current free block with the adjacent free block and returns the new block head pointer
+ * @brief: compares the key (block size, block address) of a large block tree node with a given key
  * 
- * @param ptr: address of the block
+ * @param node: large block tree node
+ * @param size: size of the key
+ * @param addr: address of the key
  * 
- * @return uint64_t*: the new block head pointer
+ * @return int: negative if the node is smaller than the key, 0 if equal, positive if greater
  */
-static uint64_t* coalesce(uint64_t *ptr){
+static int compare_tree_key(free_tree_node_t* node, uint64_t size, free_tree_node_t* addr) {
 
-    uint64_t block_size = get_block_size(ptr);
-    uint64_t* next_block = get_next_block(ptr);
-    uint64_t is_previous_allocated = get_is_prev_allocated(ptr);
-    uint64_t is_next_allocated = get_is_allocated(next_block);
+    uint64_t node_size = get_block_size(get_header((uint64_t *)node));
 
-    // if the previous and next blocks are allocated, return the current block
-    if(is_previous_allocated == 1 && is_next_allocated == 1){
-        return ptr;
+    if (node_size != size) {
+        return node_size < size ? -1 : 1;
     }
-    // if the previous block is free, remove it from the free list and coalesce
-    else if(is_previous_allocated == 0 && is_next_allocated == 1){
-        uint64_t* prev_block = get_prev_block(ptr);
-        remove_free_block((free_list_node_t*)get_block_payload(prev_block), get_list_index(get_block_size(prev_block)));
-        remove_free_block((free_list_node_t*)get_block_payload(ptr), get_list_index(get_block_size(ptr)));
-
-        block_size += get_block_size(prev_block);
-        write_block(prev_block, packHeader(block_size, 0, 1));
-        write_block(get_footer(ptr), packFooter(block_size, 0));
-        
-        ptr = prev_block;
-
+    if (node != addr) {
+        return node < addr ? -1 : 1;
     }
-    // if the next block is free, remove it from the free list and coalesce
-    else if(is_previous_allocated == 1 && is_next_allocated == 0){
+    return 0;
 
-        remove_free_block((free_list_node_t*)get_block_payload(next_block), get_list_index(get_block_size(next_block)));
-        remove_free_block((free_list_node_t*)get_block_payload(ptr), get_list_index(get_block_size(ptr)));
+}
 
-        block_size += get_block_size(next_block);
-        write_block(ptr, packHeader(block_size, 0, 1));
-        write_block(get_footer(ptr), packFooter(block_size, 0));
+/**
+ * @brief: top down splay of the large block tree, brings the node closest to the key to the root
+ * 
+ * @param root: root of the tree
+ * @param size: size of the key
+ * @param addr: address of the key
+ * 
+ * @return free_tree_node_t*: the new root, either the node with the key or its predecessor or successor
+ */
+static free_tree_node_t* splay_tree(free_tree_node_t* root, uint64_t size, free_tree_node_t* addr) {
 
-    }
-    // if both the previous and next blocks are free, remove them from the free list and coalesce
-    else{
-        uint64_t* prev_block = get_prev_block(ptr);
-        remove_free_block((free_list_node_t*)get_block_payload(next_block), get_list_index(get_block_size(next_block)));
-        remove_free_block((free_list_node_t*)get_block_payload(ptr), get_list_index(get_block_size(ptr)));
-        remove_free_block((free_list_node_t*)get_block_payload(prev_block), get_list_index(get_block_size(prev_block)));
+    free_tree_node_t header;
+    free_tree_node_t* left_tree_max = &header;
+    free_tree_node_t* right_tree_min = &header;
 
-        block_size += get_block_size(prev_block) + get_block_size(next_block);
-        write_block(get_prev_block(ptr), packHeader(block_size, 0, 1));
-        write_block(get_footer(next_block), packFooter(block_size, 0));
+    if (root == NULL) {
+        return NULL;
+    }
 
-        ptr = prev_block;
+    header.left = NULL;
+    header.right = NULL;
 
+    while (1) {
+        int cmp = compare_tree_key(root, size, addr);
+        if (cmp > 0) {
+            if (root->left == NULL) {
+                break;
+            }
+            // rotate right on a zig-zig
+            if (compare_tree_key(root->left, size, addr) > 0) {
+                free_tree_node_t* child = root->left;
+                root->left = child->right;
+                child->right = root;
+                root = child;
+                if (root->left == NULL) {
+                    break;
+                }
+            }
+            // link right
+            right_tree_min->left = root;
+            right_tree_min = root;
+            root = root->left;
+        }
+        else if (cmp < 0) {
+            if (root->right == NULL) {
+                break;
+            }
+            // rotate left on a zig-zig
+            if (compare_tree_key(root->right, size, addr) < 0) {
+                free_tree_node_t* child = root->right;
+                root->right = child->left;
+                child->left = root;
+                root = child;
+                if (root->right == NULL) {
+                    break;
+                }
+            }
+            // link left
+            left_tree_max->right = root;
+            left_tree_max = root;
+            root = root->right;
+        }
+        else {
+            break;
+        }
     }
 
-    // insert the coalesced block into the free list
-    free_list_node_t* new_free_block = (free_list_node_t*)get_block_payload(ptr);
-    insert_free_block(new_free_block, get_list_index(block_size));
-    write_block(get_block_payload(ptr),*((uint64_t *)new_free_block)); // set the payload to the free list node
+    // assemble the left, middle and right trees
+    left_tree_max->right = root->left;
+    right_tree_min->left = root->right;
+    root->left = header.right;
+    root->right = header.left;
+
+    return root;
 
-    return ptr; 
 }
 
 /**
- * @brief expands the heap by new_block_size bytes and returns the pointer to the new block
+ * @brief pushes a large free block onto the list of blocks that may have pages to purge
  * 
- * @param new_block_size: size of the new block
+ * @param free_block: free block of the large block tree
  * 
- * @return uint64_t*: the pointer to the new block
+ * @return void
  */
-static uint64_t* expand_heap(uint64_t new_block_size)
-{
-
-    uint64_t* new_block_ptr = (uint64_t *)mem_sbrk(new_block_size);
-
-    if (new_block_ptr == (void *)-1)
-        return NULL;
-    
-    new_block_ptr -= (HEADER_SIZE/UINT64_T_SIZE); // New block header
-    uint64_t is_prev_allocated = get_is_prev_allocated(new_block_ptr);
-    
-    write_block(new_block_ptr, packHeader(new_block_size, 0, is_prev_allocated)); // New block header
-    write_block(get_footer(new_block_ptr), packFooter(new_block_size, 0)); // New block footer
-    write_block(get_next_block(new_block_ptr), packHeader(0, 1, 0)); // New epilogue header
-    epilogue_ptr = get_next_block(new_block_ptr);
+static void push_dirty_block(free_tree_node_t* free_block) {
 
-    int index = get_list_index(new_block_size);
+    free_tree_node_t* head = heap_ctl->dirty_blocks;
 
-    free_list_node_t* new_free_block = (free_list_node_t*)get_block_payload(new_block_ptr);
-    insert_free_block(new_free_block, index);
-    write_block(get_block_payload(new_block_ptr), *((uint64_t *) new_free_block)); // set the payload to the free list node
+    if (head == NULL) {
+        free_block->prev_dirty = free_block;
+        free_block->next_dirty = free_block;
+    }
+    else {
+        free_block->prev_dirty = head->prev_dirty;
+        free_block->next_dirty = head;
+        head->prev_dirty->next_dirty = free_block;
+        head->prev_dirty = free_block;
+    }
 
-    return coalesce(new_block_ptr);
+    heap_ctl->dirty_blocks = free_block;
 
 }
 
-
 /**
- * @brief finds the first fit free block of size size
+ * @brief removes a large free block from the list of blocks that may have pages to purge
  * 
- * @param size: size of the block
+ * @param free_block: free block on the list
  * 
- * @return uint64_t*: the pointer to the first fit free block
+ * @return void
  */
-static uint64_t* find_first_fit(uint64_t size) {
+static void remove_dirty_block(free_tree_node_t* free_block) {
 
-    free_list_node_t *current_block_ptr;
-    
-    int index = get_list_index(size);
-    
-    for (int i = index; i < 14; i++) {
-        if (free_list[i].head == NULL) {
-            continue;
-        }
-        //search for a free block of sufficient size
-        for (current_block_ptr = free_list[i].head; get_block_size(get_header((uint64_t *)current_block_ptr)) > 0; current_block_ptr = current_block_ptr->next) {
-            if(get_block_size(get_header((uint64_t *)current_block_ptr)) >= size){
-                remove_free_block(current_block_ptr, i);
-                return get_header((uint64_t *)current_block_ptr);
-            }
-            else if(current_block_ptr == free_list[i].head->prev){
-                break; 
-            }
+    if (free_block->next_dirty == free_block) {
+        heap_ctl->dirty_blocks = NULL;
+    }
+    else {
+        free_block->prev_dirty->next_dirty = free_block->next_dirty;
+        free_block->next_dirty->prev_dirty = free_block->prev_dirty;
+        if (heap_ctl->dirty_blocks == free_block) {
+            heap_ctl->dirty_blocks = free_block->next_dirty;
         }
     }
-    
-    return NULL;
+
+    free_block->prev_dirty = NULL;
+    free_block->next_dirty = NULL;
 
 }
 
 /**
- * @brief finds the best fit free block of size size in an index, if not found, search first fit in the next index
+ * @brief inserts a free block into the large block tree
  * 
- * @param size: size of the block
+ * @param free_block: free block to be inserted
  * 
- * @return uint64_t*: the pointer to the best fit free block
+ * @return void
  */
-static uint64_t* find_best_fit(uint64_t size){
-    free_list_node_t *current_block_ptr;
+static void insert_tree_block(free_tree_node_t* free_block) {
 
-    free_list_node_t *best_free_block_ptr = NULL;
-    uint64_t best_block_size = UINT64_MAX;
-    int best_index;
-    
-    int index = get_list_index(size);
+    uint64_t size = get_block_size(get_header((uint64_t *)free_block));
+    free_tree_node_t* root = splay_tree(heap_ctl->large_tree, size, free_block);
 
-    for (int i = index; i < 14; i++) {
+    if (root == NULL) {
+        free_block->left = NULL;
+        free_block->right = NULL;
+    }
+    // the root is the predecessor or the successor of the new block
+    else if (compare_tree_key(root, size, free_block) > 0) {
+        free_block->left = root->left;
+        free_block->right = root;
+        root->left = NULL;
+    }
+    else {
+        free_block->right = root->right;
+        free_block->left = root;
+        root->right = NULL;
+    }
 
-        if (free_list[i].head == NULL) {
-            continue;
-        }
+    heap_ctl->large_tree = free_block;
+    push_dirty_block(free_block);
 
-        //search for a free block of best size
-        current_block_ptr = free_list[i].head;
-        do{
-            if(get_block_size(get_header((uint64_t *)current_block_ptr)) == size){
-                remove_free_block(current_block_ptr, i);
-                return get_header((uint64_t *)current_block_ptr);
-            }
-            else if(get_block_size(get_header((uint64_t *)current_block_ptr)) > size && get_block_size(get_header((uint64_t *)current_block_ptr)) < best_block_size){
-                best_free_block_ptr = current_block_ptr;
-                best_block_size = get_block_size(get_header((uint64_t *)current_block_ptr));
-                best_index = i;
-
-                if (i != index){
-                    remove_free_block(best_free_block_ptr, best_index);
-                    return get_header((uint64_t *)best_free_block_ptr);
-                }
+}
+
+/**
+ * @brief removes a free block from the large block tree
+ * 
+ * @param free_block: free block to be removed
+ * 
+ * @return void
+ */
+static void remove_tree_block(free_tree_node_t* free_block) {
+
+    uint64_t size = get_block_size(get_header((uint64_t *)free_block));
+    free_tree_node_t* root = splay_tree(heap_ctl->large_tree, size, free_block);
+
+    dbg_assert(root == free_block);
+
+    if (root->left == NULL) {
+        heap_ctl->large_tree = root->right;
+    }
+    else {
+        // every key of the left subtree is smaller, so splaying it brings its maximum to the root
+        free_tree_node_t* new_root = splay_tree(root->left, size, free_block);
+        new_root->right = root->right;
+        heap_ctl->large_tree = new_root;
+    }
+
+    free_block->left = NULL;
+    free_block->right = NULL;
+    if (free_block->next_dirty != NULL) {
+        remove_dirty_block(free_block);
+    }
+
+}
+
+/**
+ * @brief finds the best fit free block of size size in the large block tree and removes it from the tree
+ * Among blocks of the same size the lowest address is chosen.
+ * 
+ * @param size: size of the block
+ * 
+ * @return uint64_t*: the pointer to the best fit free block, NULL if no block fits
+ */
+static uint64_t* find_best_fit_tree(uint64_t size) {
+
+    // no block has address 0, so the root ends up next to the smallest key (size, address) of at least size
+    free_tree_node_t* root = splay_tree(heap_ctl->large_tree, size, NULL);
+    heap_ctl->large_tree = root;
+
+    if (root == NULL) {
+        return NULL;
+    }
+
+    free_tree_node_t* best_block = root;
+
+    // the root is the predecessor, so the best fit is the minimum of the right subtree
+    if (get_block_size(get_header((uint64_t *)root)) < size) {
+        if (root->right == NULL) {
+            return NULL;
+        }
+        best_block = root->right;
+        while (best_block->left != NULL) {
+            best_block = best_block->left;
+        }
+    }
+
+    remove_tree_block(best_block);
+    return get_header((uint64_t *)best_block);
+
+}
+
+/**
+ * @brief reads the next link of a free list node
+ * 
+ * @param node: free list node
+ * 
+ * @return free_list_node_t*: the next node, NULL if the node is in no list
+ */
+static free_list_node_t* get_next_node(free_list_node_t* node) {
+
+    model_cache_access(node);
+#ifdef MM_COMPACT
+    return node->next == 0 ? NULL : (free_list_node_t *)((char *)heap_ctl + (uint64_t)node->next * ALIGNMENT);
+#else
+    return node->next;
+#endif
+
+}
+
+/**
+ * @brief reads the previous link of a free list node
+ * 
+ * @param node: free list node
+ * 
+ * @return free_list_node_t*: the previous node, NULL if the node is in no list
+ */
+static free_list_node_t* get_prev_node(free_list_node_t* node) {
+
+    model_cache_access(node);
+#ifdef MM_COMPACT
+    return node->prev == 0 ? NULL : (free_list_node_t *)((char *)heap_ctl + (uint64_t)node->prev * ALIGNMENT);
+#else
+    return node->prev;
+#endif
+
+}
+
+/**
+ * @brief writes the next link of a free list node
+ * 
+ * @param node: free list node
+ * @param next: next node, NULL for none
+ * 
+ * @return void
+ */
+static void set_next_node(free_list_node_t* node, free_list_node_t* next) {
+
+    model_cache_access(node);
+#ifdef MM_COMPACT
+    node->next = next == NULL ? 0 : (uint32_t)(((char *)next - (char *)heap_ctl) / ALIGNMENT);
+#else
+    node->next = next;
+#endif
+
+}
+
+/**
+ * @brief writes the previous link of a free list node
+ * 
+ * @param node: free list node
+ * @param prev: previous node, NULL for none
+ * 
+ * @return void
+ */
+static void set_prev_node(free_list_node_t* node, free_list_node_t* prev) {
+
+    model_cache_access(node);
+#ifdef MM_COMPACT
+    node->prev = prev == NULL ? 0 : (uint32_t)(((char *)prev - (char *)heap_ctl) / ALIGNMENT);
+#else
+    node->prev = prev;
+#endif
+
+}
+
+/**
+ * @brief inserts a free block into the free list
+ * 
+ * @param free_block: free block to be inserted
+ * @param index: index of the free list
+ * 
+ * @return void
+ */
+static void __attribute__ ((noinline)) insert_free_block(free_list_node_t* free_block, int index) {
+
+    if (index == LARGE_LIST_INDEX) {
+        insert_tree_block((free_tree_node_t*)free_block);
+        return;
+    }
+
+    free_list_t* free_list = heap_ctl->free_list;
+    uint16_t granules = (uint16_t)(get_block_size(get_header((uint64_t *)free_block)) / ALIGNMENT);
+
+    //if the free list is empty
+    if (free_list[index].head == NULL) {
+        free_list[index].head = free_block;
+        heap_ctl->list_max[index] = granules;
+        set_next_node(free_block, free_block);
+        set_prev_node(free_block, free_block);
+
+        // mark the list as non-empty in the bitmaps
+        heap_ctl->sl_bitmap[index / SL_INDEX_COUNT] |= (uint8_t)(1u << (index % SL_INDEX_COUNT));
+        heap_ctl->fl_bitmap |= 1u << (index / SL_INDEX_COUNT);
+    } 
+    // if the free list is not empty
+    else {
+        free_list_node_t* head = free_list[index].head;
+        free_list_node_t* tail = get_prev_node(head);
+        set_next_node(free_block, head);
+        set_prev_node(free_block, tail);
+        set_next_node(tail, free_block);
+        set_prev_node(head, free_block);
+        if (granules > heap_ctl->list_max[index]) {
+            heap_ctl->list_max[index] = granules;
+        }
+    }
+
+}
+
+/**
+ * @brief: removes a free block from the free list
+ * 
+ * @param free_block: free block to be removed
+ * @param index: index of the free list
+ * 
+ * @return void
+ */
+static void __attribute__ ((noinline)) remove_free_block(free_list_node_t* free_block, int index) {
+
+    if (index == LARGE_LIST_INDEX) {
+        remove_tree_block((free_tree_node_t*)free_block);
+        return;
+    }
+
+    free_list_t* free_list = heap_ctl->free_list;
+
+    // If the free block is the head of the free list
+    if (free_block == free_list[index].head) {
+        // if free block is the only block in the free list
+        if (get_next_node(free_block) == free_block) {
+            set_next_node(free_block, NULL);
+            set_prev_node(free_block, NULL);
+            free_list[index].head = NULL;
+
+            // mark the list as empty in the bitmaps
+            heap_ctl->sl_bitmap[index / SL_INDEX_COUNT] &= (uint8_t)~(1u << (index % SL_INDEX_COUNT));
+            if (heap_ctl->sl_bitmap[index / SL_INDEX_COUNT] == 0) {
+                heap_ctl->fl_bitmap &= ~(1u << (index / SL_INDEX_COUNT));
+            }
+            return;
+        } else {
+            free_list[index].head = get_next_node(free_block);
+        }
+    }
+    // if the free block is not the head of the free list
+    free_list_node_t* prev = get_prev_node(free_block);
+    free_list_node_t* next = get_next_node(free_block);
+    set_next_node(prev, next);
+    set_prev_node(next, prev);
+    set_next_node(free_block, NULL);
+    set_prev_node(free_block, NULL);
+
+    return; 
+
+}
+
+/**
+ * @brief returns the size of the heap, from its control block to its epilogue
+ * 
+ * @return uint64_t: the heap size
+ */
+static uint64_t get_heap_size(void) {
+
+    return (uint64_t)((char *)heap_ctl->epilogue_ptr + EPILOGUE_SIZE - (char *)heap_ctl);
+
+}
+
+/**
+ * @brief extends the heap by incr bytes, in the region of the reserved space it grows in
+ * With -DMM_COMPACT, the heap does not grow to MAX_ARENA_SIZE bytes.
+ * 
+ * @param incr: number of bytes
+ * 
+ * @return void*: the start of the new area, (void *)-1 on error
+ */
+static void* heap_sbrk(intptr_t incr) {
+
+#ifdef MM_COMPACT
+    if (incr > 0 && (uint64_t)incr >= MAX_ARENA_SIZE - get_heap_size()) {
+        return (void *)-1;
+    }
+#endif
+
+#ifdef MM_THREADS
+    return mm_region_sbrk(heap_ctl->region, incr);
+#else
+    return mem_sbrk(incr);
+#endif
+
+}
+
+/**
+ * @brief writes the footer of a free block, unless it is a mini block, 
+ * and clears the previous allocated bit of the next block, setting its previous mini bit if the block is a mini block
+ * 
+ * @param ptr: address of the free block, whose header is written
+ * 
+ * @return void
+ */
+static void write_free_block_end(uint64_t *ptr) {
+
+    uint64_t block_size = get_block_size(ptr);
+    uint64_t* next_block_ptr = get_next_block(ptr);
+
+    if (block_size != MINI_BLOCK_SIZE) {
+        write_block(get_footer(ptr), packFooter(block_size, 0));
+    }
+
+    write_block(next_block_ptr, (read_block(next_block_ptr) & ~(uint64_t)(0x2 | PREV_MINI_BIT)) | (block_size == MINI_BLOCK_SIZE ? PREV_MINI_BIT : 0));
+
+}
+
+/**
+ * @brief computes the link of a mini list node, its offset from the heap control block in units of ALIGNMENT bytes
+ * 
+ * @param node: mini list node
+ * 
+ * @return uint64_t: the link, above MAX_MINI_LINK if the node is too far from the heap control block to be linked
+ */
+static uint64_t get_mini_link(mini_list_node_t* node) {
+
+    return (uint64_t)((char *)node - (char *)heap_ctl) / ALIGNMENT;
+
+}
+
+/**
+ * @brief reads the node a mini list link points to
+ * 
+ * @param link: link of the node, 0 for none
+ * 
+ * @return mini_list_node_t*: the node, NULL for none
+ */
+static mini_list_node_t* get_mini_node(uint32_t link) {
+
+    return link == 0 ? NULL : (mini_list_node_t *)((char *)heap_ctl + (uint64_t)link * ALIGNMENT);
+
+}
+
+/**
+ * @brief inserts a free mini block at the head of the mini list
+ * A mini block too far from the heap control block for a 4 byte link stays off the list until it coalesces.
+ * 
+ * @param ptr: address of the free mini block
+ * 
+ * @return void
+ */
+static void insert_mini_block(uint64_t *ptr) {
+
+    mini_list_node_t* mini_block = (mini_list_node_t*)get_block_payload(ptr);
+    mini_list_node_t* head = heap_ctl->mini_list;
+    uint64_t link = get_mini_link(mini_block);
+
+    if (link > MAX_MINI_LINK) {
+        return;
+    }
+
+    model_cache_access(mini_block);
+    mini_block->prev = 0;
+    mini_block->next = head == NULL ? 0 : (uint32_t)get_mini_link(head);
+    if (head != NULL) {
+        model_cache_access(head);
+        head->prev = (uint32_t)link;
+    }
+    heap_ctl->mini_list = mini_block;
+
+}
+
+/**
+ * @brief removes a free mini block from the mini list
+ * 
+ * @param ptr: address of the free mini block
+ * 
+ * @return void
+ */
+static void remove_mini_block(uint64_t *ptr) {
+
+    mini_list_node_t* mini_block = (mini_list_node_t*)get_block_payload(ptr);
+
+    if (get_mini_link(mini_block) > MAX_MINI_LINK) {
+        return;
+    }
+
+    model_cache_access(mini_block);
+    mini_list_node_t* prev = get_mini_node(mini_block->prev);
+    mini_list_node_t* next = get_mini_node(mini_block->next);
+
+    if (prev == NULL) {
+        heap_ctl->mini_list = next;
+    } else {
+        model_cache_access(prev);
+        prev->next = mini_block->next;
+    }
+    if (next != NULL) {
+        model_cache_access(next);
+        next->prev = mini_block->prev;
+    }
+
+}
+
+/**
+ * @brief removes a free block from its free list, or clears the wilderness if it is the wilderness block
+ * Mini blocks are unlinked from the mini list.
+ * 
+ * @param ptr: address of the free block
+ * 
+ * @return void
+ */
+static void detach_free_block(uint64_t *ptr) {
+
+    if (ptr == heap_ctl->wilderness) {
+        heap_ctl->wilderness = NULL;
+    } else if (get_block_size(ptr) == MINI_BLOCK_SIZE) {
+        remove_mini_block(ptr);
+    } else {
+        remove_free_block((free_list_node_t*)get_block_payload(ptr), get_list_index(get_block_size(ptr)));
+    }
+
+}
+
+/**
+ * @brief inserts a free block into its free list, or makes it the wilderness block if it ends at the epilogue
+ * Mini blocks go to the mini list.
+ * 
+ * @param ptr: address of the free block
+ * 
+ * @return void
+ */
+static void attach_free_block(uint64_t *ptr) {
+
+    if (get_next_block(ptr) == heap_ctl->epilogue_ptr) {
+        heap_ctl->wilderness = ptr;
+    } else if (get_block_size(ptr) == MINI_BLOCK_SIZE) {
+        insert_mini_block(ptr);
+    } else {
+        insert_free_block((free_list_node_t*)get_block_payload(ptr), get_list_index(get_block_size(ptr)));
+    }
+
+}
+
+/**
+ * @brief coalesces the current free block, which is in no free list, with the adjacent free blocks, 
+ * attaches the result and returns the new block head pointer
+ * 
+ * @param ptr: address of the block
+ * 
+ * @return uint64_t*: the new block head pointer
+ */
+static uint64_t* coalesce(uint64_t *ptr){
+
+    uint64_t block_size = get_block_size(ptr);
+    uint64_t* next_block = get_next_block(ptr);
+    uint64_t is_previous_allocated = get_is_prev_allocated(ptr);
+    uint64_t is_next_allocated = get_is_allocated(next_block);
+
+    // if the previous and next blocks are allocated, the current block is attached as it is
+    // if the previous block is free, remove it from the free list and coalesce
+    if(is_previous_allocated == 0 && is_next_allocated == 1){
+        uint64_t* prev_block = get_prev_block(ptr);
+        detach_free_block(prev_block);
+
+        block_size += get_block_size(prev_block);
+        write_block(prev_block, packHeader(block_size, 0, 1));
+        write_free_block_end(prev_block);
+        
+        ptr = prev_block;
+
+    }
+    // if the next block is free, remove it from the free list and coalesce
+    else if(is_previous_allocated == 1 && is_next_allocated == 0){
+
+        detach_free_block(next_block);
+
+        block_size += get_block_size(next_block);
+        write_block(ptr, packHeader(block_size, 0, 1));
+        write_free_block_end(ptr);
+
+    }
+    // if both the previous and next blocks are free, remove them from the free list and coalesce
+    else if(is_previous_allocated == 0 && is_next_allocated == 0){
+        uint64_t* prev_block = get_prev_block(ptr);
+        detach_free_block(next_block);
+        detach_free_block(prev_block);
+
+        block_size += get_block_size(prev_block) + get_block_size(next_block);
+        write_block(prev_block, packHeader(block_size, 0, 1));
+        write_free_block_end(prev_block);
+
+        ptr = prev_block;
+
+    }
+
+    // insert the coalesced block into the free list, or keep it as the wilderness
+    attach_free_block(ptr);
+
+    return ptr; 
+}
+
+/**
+ * @brief reads if a free block is known to be zero past its free list node, from its footer
+ * 
+ * @param ptr: address of the free block
+ * 
+ * @return bool: true if the payload is zero from sizeof(free_tree_node_t) bytes in up to the footer
+ */
+static bool is_zero_block(uint64_t *ptr) {
+
+    return get_block_size(ptr) != MINI_BLOCK_SIZE && (read_block(get_footer(ptr)) & ZERO_BIT) != 0;
+
+}
+
+/**
+ * @brief marks a free block as zero past its free list node, in its footer
+ * 
+ * @param ptr: address of the free block, not a mini block
+ * 
+ * @return void
+ */
+static void set_zero_block(uint64_t *ptr) {
+
+    write_block(get_footer(ptr), read_block(get_footer(ptr)) | ZERO_BIT);
+
+}
+
+/**
+ * @brief rounds up the number of bytes to grow the heap by so that, with huge pages, the heap ends on a huge page boundary
+ * 
+ * @param size: minimum number of bytes to add
+ * 
+ * @return uint64_t: number of bytes to add
+ */
+static uint64_t round_heap_increment(uint64_t size)
+{
+
+    if (huge_page_size == 0) {
+        return size;
+    }
+
+    uint64_t brk = (uint64_t)heap_sbrk(0);
+    return ((brk + size + huge_page_size - 1) & ~(huge_page_size - 1)) - brk;
+
+}
+
+/**
+ * @brief expands the heap by at least min_size bytes, merging the new memory into the wilderness block
+ * 
+ * The heap grows in chunks of heap_ctl->grow_size bytes. The chunk doubles, up to MAX_GROW_SIZE and 
+ * 1/GROW_SIZE_HEAP_RATIO of the heap, when the previous chunk was used up within GROW_WINDOW carves, 
+ * and halves otherwise. An empty heap grows by min_size only, so a heap of a few blocks is not padded by a chunk.
+ * 
+ * @param min_size: minimum number of bytes to add
+ * 
+ * @return uint64_t*: the pointer to the wilderness block
+ */
+static uint64_t* expand_heap(uint64_t min_size)
+{
+
+    // adapt the chunk size to the recent growth rate
+    uint64_t max_grow_size = align(get_heap_size() / GROW_SIZE_HEAP_RATIO);
+    if (max_grow_size > MAX_GROW_SIZE) {
+        max_grow_size = MAX_GROW_SIZE;
+    }
+    if (heap_ctl->carve_count < GROW_WINDOW) {
+        heap_ctl->grow_size = heap_ctl->grow_size * 2 < max_grow_size ? heap_ctl->grow_size * 2 : max_grow_size;
+    } else {
+        heap_ctl->grow_size = align(heap_ctl->grow_size / 2);
+    }
+    if (heap_ctl->grow_size < MIN_GROW_SIZE) {
+        heap_ctl->grow_size = MIN_GROW_SIZE;
+    }
+    heap_ctl->carve_count = 0;
+
+    uint64_t new_block_size = min_size > heap_ctl->grow_size ? min_size : heap_ctl->grow_size;
+
+    //the first chunk of the heap is sized to the request
+    if (get_next_block(heap_ctl->prologue_ptr) == heap_ctl->epilogue_ptr) {
+        new_block_size = min_size;
+    }
+
+    //memory past every earlier break is zero, and stays zero in the wilderness if the wilderness was zero as well
+    bool is_zero = mm_known_zero(heap_sbrk(0));
+
+    //with huge pages, the heap ends on a huge page boundary, so no huge page is left partly used
+    new_block_size = round_heap_increment(new_block_size);
+
+    uint64_t* new_block_ptr = (uint64_t *)heap_sbrk(new_block_size);
+
+    // fall back to the size of the request if the chunk does not fit, still ending on a huge page boundary
+    if (new_block_ptr == (void *)-1 && new_block_size > round_heap_increment(min_size)) {
+        new_block_size = round_heap_increment(min_size);
+        new_block_ptr = (uint64_t *)heap_sbrk(new_block_size);
+    }
+
+    if (new_block_ptr == (void *)-1)
+        return NULL;
+    
+    new_block_ptr = (uint64_t *)((char *)new_block_ptr - HEADER_SIZE); // New block header, over the old epilogue
+
+    if (get_is_prev_allocated(new_block_ptr) == 0) {
+        is_zero = is_zero && is_zero_block(get_prev_block(new_block_ptr));
+    }
+    
+    write_header(new_block_ptr, new_block_size, 0); // New block header
+    heap_ctl->epilogue_ptr = get_next_block(new_block_ptr);
+    write_block(heap_ctl->epilogue_ptr, packHeader(0, 1, 0)); // New epilogue header
+    write_free_block_end(new_block_ptr); // New block footer
+
+    uint64_t* wilderness_ptr = coalesce(new_block_ptr);
+
+    if (is_zero) {
+        if (wilderness_ptr != new_block_ptr) {
+            write_block((uint64_t *)((char *)new_block_ptr - FOOTER_SIZE), 0); // Old wilderness footer
+            write_block(new_block_ptr, 0); // New block header
+        }
+        set_zero_block(wilderness_ptr);
+    }
+
+    return wilderness_ptr;
+
+}
+
+/**
+ * @brief takes the wilderness block for a block of size bytes, expanding the heap if it is too small
+ * The caller carves the block from its start with allocate_block, and the remainder becomes the new wilderness.
+ * 
+ * @param size: size of the block
+ * 
+ * @return uint64_t*: the pointer to the wilderness block, which is no longer the wilderness
+ */
+static uint64_t* take_wilderness(uint64_t size)
+{
+
+    uint64_t* wilderness_ptr = heap_ctl->wilderness;
+    uint64_t wilderness_size = wilderness_ptr == NULL ? 0 : get_block_size(wilderness_ptr);
+
+    heap_ctl->carve_count++;
+
+    if (wilderness_size < size) {
+        wilderness_ptr = expand_heap(size - wilderness_size);
+        if (wilderness_ptr == NULL) {
+            return NULL;
+        }
+    }
+
+    heap_ctl->wilderness = NULL;
+    return wilderness_ptr;
+
+}
+
+
+/**
+ * @brief scans a free list for the first free block of at least size bytes and removes it from the list
+ * 
+ * A scan that finds no fit tightens the size bound of the list to its largest block.
+ * 
+ * @param size: size of the block
+ * @param index: index of the free list
+ * 
+ * @return uint64_t*: the pointer to the first fit free block, NULL if none fits
+ */
+static uint64_t* find_fit_in_list(uint64_t size, int index) {
+
+    free_list_node_t *head = heap_ctl->free_list[index].head;
+    free_list_node_t *current_block_ptr = head;
+    uint64_t max_size = 0;
+
+    //no block of the list is large enough
+    if (head == NULL || size / ALIGNMENT > heap_ctl->list_max[index]) {
+        return NULL;
+    }
+
+    do {
+#ifdef MM_FIT_STATS
+        heap_ctl->fit_node_count++;
+#endif
+        uint64_t block_size = get_block_size(get_header((uint64_t *)current_block_ptr));
+        if (block_size >= size) {
+            remove_free_block(current_block_ptr, index);
+            return get_header((uint64_t *)current_block_ptr);
+        }
+        if (block_size > max_size) {
+            max_size = block_size;
+        }
+        current_block_ptr = get_next_node(current_block_ptr);
+    } while (current_block_ptr != head);
+
+    heap_ctl->list_max[index] = (uint16_t)(max_size / ALIGNMENT);
+    return NULL;
+
+}
+
+/**
+ * @brief finds a free block of size size and removes it from the free list
+ * 
+ * The subclass of the request is scanned first fit, since it may hold blocks just big enough.
+ * Otherwise the head of the next non-empty subclass is taken, where every block fits.
+ * Requests above LARGE_BLOCK_SIZE, or that no subclass can satisfy, take the best fit of the large block tree.
+ * 
+ * @param size: size of the block
+ * 
+ * @return uint64_t*: the pointer to the first fit free block
+ */
+static uint64_t* find_first_fit(uint64_t size) {
+
+    int index = get_list_index(size);
+
+    if (index != LARGE_LIST_INDEX) {
+        uint64_t* block_ptr = find_fit_in_list(size, index);
+        if (block_ptr != NULL) {
+            return block_ptr;
+        }
+
+        int suitable_index = find_suitable_index(size);
+        if (suitable_index >= 0) {
+            free_list_node_t *free_block = heap_ctl->free_list[suitable_index].head;
+            remove_free_block(free_block, suitable_index);
+            return get_header((uint64_t *)free_block);
+        }
+    }
+
+    return find_best_fit_tree(size);
+
+}
+
+/**
+ * @brief allocates a block of size size
+ * 
+ * @param ptr: address of the block
+ * @param size: size of the block
+ * 
+ * @return void
+ */
+static void allocate_block(uint64_t *ptr, uint64_t size) {
+
+    uint64_t block_size = get_block_size(ptr);
+
+    if (block_size - size >= MINI_BLOCK_SIZE) {
+
+        //divided allocated block memory and remaining free memory, which may be a mini block
+
+        write_header(ptr, size, 1); // New allocated block header
+
+        uint64_t* new_free_block = get_next_block(ptr);
+        write_block(new_free_block, packHeader(block_size - size, 0, 1)); // New free block header
+        write_free_block_end(new_free_block); // New free block footer, and previous bits of the next block
+
+        // the remainder may border a free block when shrinking in place
+        coalesce(new_free_block);
+
+    } else {
+        //allocated all the remaining memory to the allocated block
+
+        write_header(ptr, block_size, 1); // New allocated block header
+
+        set_prev_allocated(get_next_block(ptr), 1); // update header of next block with previous allocated bit
+
+    }
+
+}
+
+/**
+ * @brief allocates a block of size size from a free block taken out of the free lists, 
+ * keeping the zero bit on the free remainder
+ * 
+ * @param ptr: address of the free block, or of a block carved past the gap of a free block with its footer
+ * @param size: size of the block
+ * 
+ * @return bool: true if the free block was zero past its free list node
+ */
+static bool allocate_free_block(uint64_t *ptr, uint64_t size) {
+
+    bool is_zero = is_zero_block(ptr);
+
+    allocate_block(ptr, size);
+
+    //the remainder keeps the old footer, and its header and node fall in the zero payload of the free block
+    uint64_t* remainder_ptr = get_next_block(ptr);
+    if (is_zero && get_is_allocated(remainder_ptr) == 0 && get_block_size(remainder_ptr) != MINI_BLOCK_SIZE) {
+        set_zero_block(remainder_ptr);
+    }
+
+    return is_zero;
+
+}
+
+/**
+ * @brief grows an allocated block in place to size bytes, using a free next block 
+ * and, if the block is the last one in the heap, expanding the heap by the missing bytes only
+ * 
+ * @param ptr: address of the allocated block
+ * @param size: new size of the block
+ * 
+ * @return bool: true if the block was grown, false if it has to move
+ */
+static bool expand_block_in_place(uint64_t *ptr, uint64_t size) {
+
+    uint64_t* next_block_ptr = get_next_block(ptr);
+    uint64_t is_next_allocated = get_is_allocated(next_block_ptr);
+    uint64_t available_size = get_block_size(ptr);
+
+    if (is_next_allocated == 0) {
+        available_size += get_block_size(next_block_ptr);
+    }
+
+    if (available_size < size) {
+        // the block can only grow past its free neighbour at the end of the heap
+        uint64_t* end_ptr = is_next_allocated == 1 ? next_block_ptr : get_next_block(next_block_ptr);
+        uint64_t increment = round_heap_increment(size - available_size);
+        if (end_ptr != heap_ctl->epilogue_ptr || heap_sbrk(increment) == (void *)-1) {
+            return false;
+        }
+
+        if (is_next_allocated == 0) {
+            detach_free_block(next_block_ptr);
+        }
+
+        write_header(ptr, available_size + increment, 1); // New allocated block header
+        heap_ctl->epilogue_ptr = get_next_block(ptr);
+        write_block(heap_ctl->epilogue_ptr, packHeader(0, 1, 1)); // New epilogue header
+
+        // with huge pages, the rest of the last huge page is split off as the new wilderness
+        allocate_block(ptr, size);
+
+        return true;
+    }
+
+    if (is_next_allocated == 0) {
+        detach_free_block(next_block_ptr);
+        write_header(ptr, available_size, 1); // Merged block header
+    }
+
+    // split off the remainder, if any
+    allocate_block(ptr, size);
+
+    return true;
+
+}
+
+/**
+ * @brief grows an allocated block to size bytes by merging it with a free previous block (and a free next block),
+ * moving the payload to the start of the previous block
+ * 
+ * @param ptr: address of the allocated block
+ * @param size: new size of the block
+ * 
+ * @return uint64_t*: the address of the merged block, NULL if the neighbours are too small
+ */
+static uint64_t* merge_with_prev_block(uint64_t *ptr, uint64_t size) {
+
+    if (get_is_prev_allocated(ptr) == 1) {
+        return NULL;
+    }
+
+    uint64_t block_size = get_block_size(ptr);
+    uint64_t* prev_block_ptr = get_prev_block(ptr);
+    uint64_t* next_block_ptr = get_next_block(ptr);
+    uint64_t is_next_allocated = get_is_allocated(next_block_ptr);
+    uint64_t available_size = get_block_size(prev_block_ptr) + block_size;
+
+    if (is_next_allocated == 0) {
+        available_size += get_block_size(next_block_ptr);
+    }
+
+    if (available_size < size) {
+        return NULL;
+    }
+
+    detach_free_block(prev_block_ptr);
+    if (is_next_allocated == 0) {
+        detach_free_block(next_block_ptr);
+    }
+
+    write_header(prev_block_ptr, available_size, 1); // Merged block header
+
+    // the payloads overlap when the previous block is smaller than the payload
+    memmove(get_block_payload(prev_block_ptr), get_block_payload(ptr), block_size - HEADER_SIZE);
+
+    // split off the remainder, if any
+    allocate_block(prev_block_ptr, size);
+
+    return prev_block_ptr;
+
+}
+
+/**
+ * @brief returns the time of a monotonic clock
+ * 
+ * @return uint64_t: the time in ns
+ */
+static uint64_t get_time_ns(void)
+{
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+
+}
+
+/**
+ * @brief gives back the page-aligned interior of a free block, past its links and before its footer, 
+ * and marks the block purged in its footer. The mark goes away when the footer is next written, 
+ * that is when the block is split or coalesced. The partial pages at both ends are cleared, 
+ * so the block is marked zero as well, unless the ends span huge pages.
+ * 
+ * @param ptr: address of the free block
+ * 
+ * @return uint64_t: number of bytes purged, 0 if the block was purged already or has no whole page to purge
+ */
+static uint64_t purge_free_block(uint64_t *ptr)
+{
+
+    uint64_t* footer_ptr = get_footer(ptr);
+
+    if (read_block(footer_ptr) & PURGED_BIT) {
+        return 0;
+    }
+
+    //with huge pages, only whole huge pages are purged, so none is split into small pages
+    uint64_t page_size = huge_page_size != 0 ? huge_page_size : (uint64_t)mm_pagesize();
+    uint64_t start = ((uint64_t)get_block_payload(ptr) + sizeof(free_tree_node_t) + page_size - 1) & ~(page_size - 1);
+    uint64_t end = (uint64_t)footer_ptr & ~(page_size - 1);
+
+    if (start >= end || mm_purge((void *)start, end - start) != 0) {
+        return 0;
+    }
+    write_block(footer_ptr, read_block(footer_ptr) | PURGED_BIT);
+
+    if (huge_page_size == 0) {
+        uint64_t zero_start = (uint64_t)get_block_payload(ptr) + sizeof(free_tree_node_t);
+        memset((void *)zero_start, 0, start - zero_start);
+        memset((void *)end, 0, (uint64_t)footer_ptr - end);
+        write_block(footer_ptr, read_block(footer_ptr) | ZERO_BIT);
+    }
+
+    return end - start;
+
+}
+
+/**
+ * @brief purges the large free blocks that may have pages to purge, oldest first, until size bytes are purged
+ * Each block leaves the list once visited, whether or not it had a whole page to give back, 
+ * so no block is visited twice until it is split or coalesced again.
+ * 
+ * @param size: number of bytes to purge
+ * 
+ * @return uint64_t: number of bytes purged
+ */
+static uint64_t purge_dirty_blocks(uint64_t size)
+{
+
+    uint64_t purged_size = 0;
+
+    while (purged_size < size && heap_ctl->dirty_blocks != NULL) {
+        free_tree_node_t* oldest = heap_ctl->dirty_blocks->prev_dirty;
+        remove_dirty_block(oldest);
+        purged_size += purge_free_block(get_header((uint64_t *)oldest));
+    }
+
+    return purged_size;
+
+}
+
+/**
+ * @brief shrinks the heap by up to size bytes of the wilderness, keeping TRIM_PAD bytes of it for the next allocations
+ * 
+ * @param size: number of bytes to give back
+ * 
+ * @return uint64_t: number of bytes the heap shrank by
+ */
+static uint64_t trim_heap(uint64_t size)
+{
+
+    uint64_t* wilderness_ptr = heap_ctl->wilderness;
+
+    if (wilderness_ptr == NULL || get_block_size(wilderness_ptr) <= TRIM_PAD) {
+        return 0;
+    }
+
+    uint64_t wilderness_size = get_block_size(wilderness_ptr);
+    uint64_t trim_size = wilderness_size - TRIM_PAD < size ? wilderness_size - TRIM_PAD : size;
+    trim_size &= ~(uint64_t)(ALIGNMENT - 1);
+
+    //with huge pages, the heap ends on a huge page boundary after the trim
+    if (huge_page_size != 0) {
+        uint64_t brk = (uint64_t)heap_sbrk(0);
+        uint64_t new_brk = (brk - trim_size + huge_page_size - 1) & ~(huge_page_size - 1);
+        trim_size = new_brk < brk ? brk - new_brk : 0;
+    }
+
+    if (trim_size == 0) {
+        return 0;
+    }
+
+    bool is_zero = is_zero_block(wilderness_ptr);
+
+    if (heap_sbrk(-(intptr_t)trim_size) == (void *)-1) {
+        return 0;
+    }
+
+    write_header(wilderness_ptr, wilderness_size - trim_size, 0); // Shrunk wilderness header
+    heap_ctl->epilogue_ptr = get_next_block(wilderness_ptr);
+    write_block(heap_ctl->epilogue_ptr, packHeader(0, 1, 0)); // New epilogue header
+    write_free_block_end(wilderness_ptr); // Shrunk wilderness footer
+
+    if (is_zero) {
+        set_zero_block(wilderness_ptr);
+    }
+
+    return trim_size;
+
+}
+
+/**
+ * @brief gives memory back once the dirty bytes exceed the decay limit, trimming the wilderness first 
+ * and then purging the large free blocks
+ * 
+ * The bytes made dirty in each of the last DECAY_STEPS epochs of decay_ms / DECAY_STEPS ms may stay dirty 
+ * in a proportion that falls from 1 to 0 along a smoothstep curve as they age, so memory freed in a burst 
+ * is given back gradually and memory reused soon after it is freed is not faulted in again.
+ * 
+ * @param size: number of bytes just made dirty
+ * 
+ * @return void
+ */
+static void decay_dirty_memory(uint64_t size)
+{
+
+    uint64_t limit = 0;
+
+    if (decay_ms < 0) {
+        return;
+    }
+
+    if (decay_ms > 0) {
+        //shift the backlog by the epochs elapsed since the last call
+        uint64_t now = get_time_ns();
+        uint64_t epoch_ns = (uint64_t)decay_ms * 1000000 / DECAY_STEPS;
+        uint64_t steps = epoch_ns == 0 ? DECAY_STEPS : (now - heap_ctl->decay_epoch) / epoch_ns;
+        if (steps >= DECAY_STEPS) {
+            for (int i = 0; i < DECAY_STEPS; i++) {
+                heap_ctl->decay_backlog[i] = 0;
+            }
+            heap_ctl->decay_epoch = now;
+        } else if (steps > 0) {
+            for (int i = DECAY_STEPS - 1; i >= 0; i--) {
+                heap_ctl->decay_backlog[i] = i >= (int)steps ? heap_ctl->decay_backlog[i - steps] : 0;
+            }
+            heap_ctl->decay_epoch += steps * epoch_ns;
+        }
+        heap_ctl->decay_backlog[0] += size;
+
+        //smoothstep weight x * x * (3 - 2 * x) of each epoch, in 1/65536, x falling from 1 for the newest epoch
+        for (uint64_t i = 0; i < DECAY_STEPS; i++) {
+            uint64_t x = ((DECAY_STEPS - i) << 16) / DECAY_STEPS;
+            uint64_t weight = ((x * x) >> 16) * (3 * 65536 - 2 * x) >> 16;
+            limit += (heap_ctl->decay_backlog[i] * weight) >> 16;
+        }
+    }
+
+    if (heap_ctl->dirty_bytes < limit + PURGE_BATCH_SIZE) {
+        return;
+    }
+
+    uint64_t excess = heap_ctl->dirty_bytes - limit;
+    uint64_t purged_size = trim_heap(excess);
+
+    if (purged_size < excess) {
+        purged_size += purge_dirty_blocks(excess - purged_size);
+    }
+
+    //falling short means the rest of the dirty bytes were reused or purged already
+    heap_ctl->dirty_bytes = purged_size < excess ? limit : heap_ctl->dirty_bytes - purged_size;
+
+}
+
+/**
+ * @brief counts bytes freed into a large free block as dirty, and gives memory back as the decay curve allows
+ * 
+ * @param size: number of bytes freed
+ * 
+ * @return void
+ */
+static void add_dirty_bytes(uint64_t size)
+{
+
+    if (decay_ms < 0) {
+        return;
+    }
+
+    heap_ctl->dirty_bytes += size;
+    decay_dirty_memory(size);
+
+}
+
+/**
+ * @brief frees an allocated block, updating the boundary tags and coalescing it
+ * 
+ * @param header_ptr: address of the block
+ * @param block_size: size of the block
+ * 
+ * @return void
+ */
+static void release_block(uint64_t* header_ptr, uint64_t block_size)
+{
+
+    write_header(header_ptr, block_size, 0); // new free block header
+    write_free_block_end(header_ptr); // new free block footer, and previous bits of the next block (or the epilogue)
+
+    //coalesce if possible and insert into the free list
+    uint64_t* free_block_ptr = coalesce(header_ptr);
+
+    //only the pages of large free blocks are given back, so only they count as dirty
+    if (get_block_size(free_block_ptr) > LARGE_BLOCK_SIZE) {
+        add_dirty_bytes(block_size);
+    }
+
+}
+
+/**
+ * @brief pushes an allocated block onto the quick list of its size, leaving its boundary tags as they are
+ * 
+ * @param header_ptr: address of the block
+ * @param block_size: size of the block
+ * 
+ * @return void
+ */
+static void push_quick_block(uint64_t* header_ptr, uint64_t block_size)
+{
+
+    quick_list_node_t* quick_block = (quick_list_node_t*)get_block_payload(header_ptr);
+    int index = (int)(block_size / ALIGNMENT) - QUICK_LIST_OFFSET;
+
+    write_block(header_ptr, read_block(header_ptr) | QUICK_BIT);
+    quick_block->next = heap_ctl->quick_list[index];
+    heap_ctl->quick_list[index] = quick_block;
+    heap_ctl->quick_bytes += block_size;
+
+}
+
+/**
+ * @brief pops a block of exactly size bytes from its quick list
+ * 
+ * @param size: size of the block
+ * 
+ * @return uint64_t*: the allocated block, NULL if the quick list is empty
+ */
+static uint64_t* pop_quick_block(uint64_t size)
+{
+
+    int index = (int)(size / ALIGNMENT) - QUICK_LIST_OFFSET;
+    quick_list_node_t* quick_block = heap_ctl->quick_list[index];
+
+    if (quick_block == NULL) {
+        return NULL;
+    }
+
+    uint64_t* header_ptr = get_header((uint64_t *)quick_block);
+
+    heap_ctl->quick_list[index] = quick_block->next;
+    heap_ctl->quick_bytes -= size;
+    write_block(header_ptr, read_block(header_ptr) & ~QUICK_BIT);
+
+    return header_ptr;
+
+}
+
+/**
+ * @brief frees every block of the quick lists for real, coalescing them
+ * 
+ * @return void
+ */
+static void consolidate_quick_lists(void)
+{
+
+    for (int i = 0; i < QUICK_LIST_COUNT; i++) {
+        while (heap_ctl->quick_list[i] != NULL) {
+            uint64_t* header_ptr = get_header((uint64_t *)heap_ctl->quick_list[i]);
+            heap_ctl->quick_list[i] = heap_ctl->quick_list[i]->next;
+            write_block(header_ptr, read_block(header_ptr) & ~QUICK_BIT);
+            release_block(header_ptr, get_block_size(header_ptr));
+        }
+    }
+
+    heap_ctl->quick_bytes = 0;
+
+}
+
+/**
+ * @brief finds a free block of at least size bytes, consolidating the quick lists 
+ * and then carving the wilderness if no free block fits
+ * 
+ * @param size: size of the block
+ * 
+ * @return uint64_t*: the free block, in no free list, NULL if the heap cannot grow
+ */
+static uint64_t* find_free_block(uint64_t size)
+{
+
+    uint64_t* free_block_ptr = find_first_fit(size);
+
+    //if no free block of sufficient size is found, coalesce the quick lists and retry
+    if (free_block_ptr == NULL && heap_ctl->quick_bytes > 0){
+        consolidate_quick_lists();
+        free_block_ptr = find_first_fit(size);
+    }
+
+    //if still no free block of sufficient size is found, carve the block from the wilderness
+    if (free_block_ptr == NULL){
+        free_block_ptr = take_wilderness(size);
+    }
+
+    return free_block_ptr;
+
+}
+
+/**
+ * @brief computes the gap to leave in front of a block at ptr so that its payload lies offset bytes past a multiple of alignment
+ * 
+ * @param ptr: address of the block
+ * @param alignment: alignment of the payload, a power of two of at least ALIGNMENT
+ * @param offset: offset of the payload from the alignment, a multiple of ALIGNMENT below alignment
+ * 
+ * @return uint64_t: the gap, a multiple of ALIGNMENT below alignment, 0 or large enough for a free block
+ */
+static uint64_t get_alignment_gap(uint64_t *ptr, uint64_t alignment, uint64_t offset)
+{
+
+    uint64_t payload = (uint64_t)get_block_payload(ptr);
+    return (((payload - offset) + alignment - 1) & ~(alignment - 1)) + offset - payload;
+
+}
+
+/**
+ * @brief scans the first ALIGNED_FIT_SCAN_LIMIT blocks of a free list for one that holds size bytes past its alignment gap 
+ * and removes it from the list
+ * 
+ * @param size: size of the block
+ * @param alignment: alignment of the payload, a power of two of at least ALIGNMENT
+ * @param offset: offset of the payload from the alignment
+ * @param index: index of the free list
+ * 
+ * @return uint64_t*: the pointer to the first fit free block, NULL if none fits
+ */
+static uint64_t* find_aligned_fit_in_list(uint64_t size, uint64_t alignment, uint64_t offset, int index) {
+
+    free_list_node_t *head = heap_ctl->free_list[index].head;
+    free_list_node_t *current_block_ptr = head;
+    int scanned = 0;
+
+    if (head == NULL || size / ALIGNMENT > heap_ctl->list_max[index]) {
+        return NULL;
+    }
+
+    //blocks of the exact size only fit if they are aligned already, so the scan is bounded
+    do {
+#ifdef MM_FIT_STATS
+        heap_ctl->fit_node_count++;
+#endif
+        uint64_t* header_ptr = get_header((uint64_t *)current_block_ptr);
+        if (get_block_size(header_ptr) >= get_alignment_gap(header_ptr, alignment, offset) + size) {
+            remove_free_block(current_block_ptr, index);
+            return header_ptr;
+        }
+        current_block_ptr = get_next_node(current_block_ptr);
+    } while (current_block_ptr != head && ++scanned < ALIGNED_FIT_SCAN_LIMIT);
+
+    return NULL;
+
+}
+
+/**
+ * @brief takes the offset of the next colored payload within COLOR_PERIOD, rotating through COLOR_COUNT colors
+ * 
+ * @param step: distance between two colors, a power of two of at least COLOR_STEP
+ * 
+ * @return uint64_t: the offset of the payload from a multiple of COLOR_PERIOD
+ */
+static uint64_t next_color_offset(uint64_t step)
+{
+
+    uint64_t color = heap_ctl->next_color++ % COLOR_COUNT;
+
+    return (color * step) & (COLOR_PERIOD - 1);
+
+}
+
+/**
+ * @brief allocates a block of size bytes whose payload lies offset bytes past a multiple of alignment
+ * The blocks of the class of the request are scanned for one whose gap still leaves room for the block, 
+ * before taking a block large enough for any gap. The block is carved past the leading gap, 
+ * the gap is freed and the trailing remainder is split off by allocate_block.
+ * 
+ * @param size: size of the block
+ * @param alignment: alignment of the payload, a power of two of at least ALIGNMENT
+ * @param offset: offset of the payload from the alignment, a multiple of ALIGNMENT below alignment, 0 for aligned payloads
+ * 
+ * @return uint64_t*: the allocated block, NULL if the heap cannot grow
+ */
+static uint64_t* allocate_aligned_block(uint64_t size, uint64_t alignment, uint64_t offset)
+{
+
+    uint64_t* free_block_ptr = NULL;
+    int index = get_list_index(size);
+
+    //a block of the size of the request fits if its payload is aligned, or close enough to the alignment
+    if (index != LARGE_LIST_INDEX) {
+        free_block_ptr = find_aligned_fit_in_list(size, alignment, offset, index);
+    }
+
+    //room for the block behind the largest possible gap
+    if (free_block_ptr == NULL) {
+        free_block_ptr = find_first_fit(size + alignment);
+    }
+
+    if (free_block_ptr == NULL && heap_ctl->quick_bytes > 0){
+        consolidate_quick_lists();
+        free_block_ptr = find_first_fit(size + alignment);
+    }
+
+    //the wilderness only has to cover the gap in front of it, so aligned blocks carved in a row tile the heap
+    if (free_block_ptr == NULL){
+        uint64_t* wilderness_ptr = heap_ctl->wilderness == NULL ? heap_ctl->epilogue_ptr : heap_ctl->wilderness;
+        free_block_ptr = take_wilderness(get_alignment_gap(wilderness_ptr, alignment, offset) + size);
+        if (free_block_ptr == NULL)
+            return NULL;
+    }
+
+    uint64_t gap_size = get_alignment_gap(free_block_ptr, alignment, offset);
+
+    if (gap_size != 0) {
+        uint64_t block_size = get_block_size(free_block_ptr);
+        uint64_t* aligned_block_ptr = (uint64_t *)((char *)free_block_ptr + gap_size);
+
+        write_block(aligned_block_ptr, packHeader(block_size - gap_size, 1, 0)); // Aligned block header
+        write_header(free_block_ptr, gap_size, 0); // Gap header
+        write_free_block_end(free_block_ptr); // Gap footer
+        coalesce(free_block_ptr);
+
+        free_block_ptr = aligned_block_ptr;
+    }
+
+    allocate_free_block(free_block_ptr, size);
+    return free_block_ptr;
+
+}
+
+/**
+ * @brief finds the slab page holding ptr, from the bit of its aligned page in the slab page map of its heap
+ * In the threaded build the map is read without the arena lock: the bit of the page of an allocated slot or block 
+ * cannot change while it is allocated, and maps outgrown are never freed.
+ * 
+ * @param ptr: payload pointer
+ * 
+ * @return slab_page_t*: the slab page of ptr, NULL if ptr is the payload of a block
+ */
+static slab_page_t* get_slab_page(void* ptr)
+{
+
+    uint64_t offset = (uint64_t)ptr & (SLAB_PAGE_SIZE - 1);
+
+    //slots never overlap the descriptor
+    if (offset < SLAB_HEADER_SIZE) {
+        return NULL;
+    }
+
+    slab_page_t* page = (slab_page_t *)((char *)ptr - offset);
+
+#ifdef MM_THREADS
+    //mapped blocks lie outside the regions
+    int region = mm_region_of(ptr);
+    heap_ctl_t* heap = ptr < mm_heap_lo() || region >= ARENA_COUNT ? NULL : __atomic_load_n(&arenas[region], __ATOMIC_ACQUIRE);
+    uint64_t* map = heap == NULL ? NULL : __atomic_load_n(&heap->slab_map, __ATOMIC_ACQUIRE);
+#else
+    heap_ctl_t* heap = heap_ctl;
+    uint64_t* map = heap->slab_map;
+#endif
+
+    if (map == NULL || (char *)page < (char *)heap) {
+        return NULL;
+    }
+
+    uint64_t index = (uint64_t)((char *)page - (char *)heap) / SLAB_PAGE_SIZE;
+
+#ifdef MM_THREADS
+    bool is_slab = index < map[0] && (__atomic_load_n(&map[1 + index / 64], __ATOMIC_RELAXED) >> (index % 64) & 1) != 0;
+#else
+    bool is_slab = index < map[0] && (map[1 + index / 64] >> (index % 64) & 1) != 0;
+#endif
+
+    return is_slab ? page : NULL;
+
+}
+
+/**
+ * @brief grows the slab page map of the heap to cover the page of index index, at least doubling it
+ * The map is copied to a new allocated block. The old block is freed, except in the threaded build, 
+ * where threads of other arenas may still be reading it.
+ * 
+ * @param index: page index from the heap control block
+ * 
+ * @return bool: false if the heap cannot grow
+ */
+static bool grow_slab_map(uint64_t index)
+{
+
+    uint64_t* old_map = heap_ctl->slab_map;
+    uint64_t old_pages = old_map == NULL ? 0 : old_map[0];
+    uint64_t pages = old_pages * 2 > SLAB_MAP_MIN_PAGES ? old_pages * 2 : SLAB_MAP_MIN_PAGES;
+
+    while (pages <= index) {
+        pages *= 2;
+    }
+
+    uint64_t map_size = UINT64_T_SIZE + pages / 8;
+    uint64_t* header_ptr = find_free_block(align(map_size + HEADER_SIZE));
+    if (header_ptr == NULL) {
+        return false;
+    }
+    allocate_free_block(header_ptr, align(map_size + HEADER_SIZE));
+
+    uint64_t* map = get_block_payload(header_ptr);
+    map[0] = pages;
+    memset(map + 1, 0, pages / 8);
+    if (old_map != NULL) {
+        memcpy(map + 1, old_map + 1, old_pages / 8);
+    }
+
+#ifdef MM_THREADS
+    __atomic_store_n(&heap_ctl->slab_map, map, __ATOMIC_RELEASE);
+#else
+    heap_ctl->slab_map = map;
+    if (old_map != NULL) {
+        release_block(get_header(old_map), get_block_size(get_header(old_map)));
+    }
+#endif
+
+    return true;
+
+}
+
+/**
+ * @brief sets or clears the bit of a slab page in the slab page map of the heap, which covers the page
+ * 
+ * @param page: slab page
+ * @param is_slab: true to set the bit
+ * 
+ * @return void
+ */
+static void set_slab_map_bit(slab_page_t* page, bool is_slab)
+{
+
+    uint64_t index = (uint64_t)((char *)page - (char *)heap_ctl) / SLAB_PAGE_SIZE;
+    uint64_t* word = &heap_ctl->slab_map[1 + index / 64];
+    uint64_t bit = (uint64_t)1 << (index % 64);
+
+#ifdef MM_THREADS
+    if (is_slab) {
+        __atomic_fetch_or(word, bit, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_and(word, ~bit, __ATOMIC_RELAXED);
+    }
+#else
+    *word = is_slab ? *word | bit : *word & ~bit;
+#endif
+
+}
+
+/**
+ * @brief inserts a slab page at the head of the partial page list of its class
+ * 
+ * @param page: slab page
+ * 
+ * @return void
+ */
+static void insert_slab_page(slab_page_t* page)
+{
+
+    int index = (int)(page->slot_size / ALIGNMENT) - 1;
+
+    page->prev = NULL;
+    page->next = heap_ctl->slab_partial[index];
+    if (page->next != NULL) {
+        page->next->prev = page;
+    }
+    heap_ctl->slab_partial[index] = page;
+
+}
+
+/**
+ * @brief removes a slab page from the partial page list of its class
+ * 
+ * @param page: slab page
+ * 
+ * @return void
+ */
+static void remove_slab_page(slab_page_t* page)
+{
+
+    int index = (int)(page->slot_size / ALIGNMENT) - 1;
+
+    if (page->prev != NULL) {
+        page->prev->next = page->next;
+    } else {
+        heap_ctl->slab_partial[index] = page->next;
+    }
+    if (page->next != NULL) {
+        page->next->prev = page->prev;
+    }
+
+}
+
+/**
+ * @brief returns whether a slab page has no slot left, neither free nor untouched
+ * 
+ * @param page: slab page
+ * 
+ * @return bool: true if the page is full
+ */
+static bool is_slab_page_full(slab_page_t* page)
+{
+    return page->free_slot == NULL && page->bump_offset + page->slot_size > SLAB_PAGE_SIZE - HEADER_SIZE;
+}
+
+/**
+ * @brief carves a new slab page for slots of slot_size bytes out of the heap
+ * 
+ * @param slot_size: slot size of the page
+ * 
+ * @return slab_page_t*: the new page, in the partial page list, NULL if the heap cannot grow
+ */
+static slab_page_t* create_slab_page(uint64_t slot_size)
+{
+
+    uint64_t* header_ptr = allocate_aligned_block(SLAB_PAGE_SIZE, SLAB_PAGE_SIZE, 0);
+
+    if (header_ptr == NULL) {
+        return NULL;
+    }
+
+    slab_page_t* page = (slab_page_t *)get_block_payload(header_ptr);
+    uint64_t index = (uint64_t)((char *)page - (char *)heap_ctl) / SLAB_PAGE_SIZE;
+
+    if ((heap_ctl->slab_map == NULL || index >= heap_ctl->slab_map[0]) && !grow_slab_map(index)) {
+        release_block(header_ptr, SLAB_PAGE_SIZE);
+        return NULL;
+    }
+    set_slab_map_bit(page, true);
+
+    page->free_slot = NULL;
+    page->slot_size = (uint32_t)slot_size;
+    page->used_count = 0;
+    page->bump_offset = SLAB_HEADER_SIZE;
+
+    insert_slab_page(page);
+    heap_ctl->slab_page_count++;
+
+    return page;
+
+}
+
+/**
+ * @brief tells whether n requests of size bytes take slab slots, which they do once the heap reaches SLAB_WARM_HEAP_SIZE 
+ * or the blocks of their block size hold SLAB_WARM_BYTES live bytes, and counts them as live blocks otherwise
+ * 
+ * @param size: requested size, from 16 to MAX_SLAB_SIZE
+ * @param n: number of requests
+ * 
+ * @return bool: true if the requests take slab slots
+ */
+static bool count_slab_requests(uint64_t size, size_t n)
+{
+
+    uint64_t block_size = (uint64_t)align(size + HEADER_SIZE);
+    int index = (int)(block_size / ALIGNMENT) - 2;
+
+    if ((heap_ctl->slab_warm >> index & 1) != 0) {
+        return true;
+    }
+
+    //a heap of a few slab pages has room to spare for partly used pages, so every size takes slab slots
+    if (get_heap_size() >= SLAB_WARM_HEAP_SIZE) {
+        heap_ctl->slab_warm = (uint16_t)((1u << SLAB_CLASS_COUNT) - 1);
+        return true;
+    }
+
+    uint64_t live = heap_ctl->slab_live[index] + (uint64_t)n;
+    if (n >= SLAB_WARM_BYTES || live * block_size >= SLAB_WARM_BYTES) {
+        heap_ctl->slab_warm |= (uint16_t)(1u << index);
+        return true;
+    }
+
+    heap_ctl->slab_live[index] = (uint8_t)live;
+    return false;
+
+}
+
+/**
+ * @brief counts a freed block out of the live blocks of its block size, if requests of that size may take slab slots
+ * 
+ * @param block_size: size of the block
+ * 
+ * @return void
+ */
+static void uncount_slab_block(uint64_t block_size)
+{
+
+    if (block_size < 2 * ALIGNMENT || block_size > align(MAX_SLAB_SIZE + HEADER_SIZE)) {
+        return;
+    }
+
+    int index = (int)(block_size / ALIGNMENT) - 2;
+    if (heap_ctl->slab_live[index] > 0) {
+        heap_ctl->slab_live[index]--;
+    }
+
+}
+
+/**
+ * @brief allocates a slot of the slab class of size bytes
+ * 
+ * @param size: requested size, at most MAX_SLAB_SIZE
+ * 
+ * @return void*: the slot, NULL if the heap cannot grow
+ */
+static void* allocate_slab_slot(uint64_t size)
+{
+
+    uint64_t slot_size = align(size);
+    slab_page_t* page = heap_ctl->slab_partial[slot_size / ALIGNMENT - 1];
+
+    if (page == NULL && (page = create_slab_page(slot_size)) == NULL) {
+        return NULL;
+    }
+
+    //reuse a freed slot, or take the next untouched one
+    slab_slot_t* slot = page->free_slot;
+    if (slot != NULL) {
+        page->free_slot = slot->next;
+    } else {
+        slot = (slab_slot_t *)((char *)page + page->bump_offset);
+        page->bump_offset += slot_size;
+    }
+    page->used_count++;
+
+    if (is_slab_page_full(page)) {
+        remove_slab_page(page);
+    }
+
+    return slot;
+
+}
+
+/**
+ * @brief allocates up to n slots of the slab class of size bytes, filling a page at a time
+ * 
+ * @param size: requested size, at most MAX_SLAB_SIZE
+ * @param n: number of slots
+ * @param out: array receiving the slots
+ * 
+ * @return size_t: number of slots allocated, less than n if the heap cannot grow
+ */
+static size_t allocate_slab_slots(uint64_t size, size_t n, void** out)
+{
+
+    uint64_t slot_size = align(size);
+    size_t count = 0;
+
+    while (count < n) {
+        slab_page_t* page = heap_ctl->slab_partial[slot_size / ALIGNMENT - 1];
+        if (page == NULL && (page = create_slab_page(slot_size)) == NULL) {
+            break;
+        }
+
+        //freed slots first, then the untouched ones, until the page is full
+        while (count < n && page->free_slot != NULL) {
+            out[count++] = page->free_slot;
+            page->free_slot = page->free_slot->next;
+            page->used_count++;
+        }
+        while (count < n && page->bump_offset + slot_size <= SLAB_PAGE_SIZE - HEADER_SIZE) {
+            out[count++] = (char *)page + page->bump_offset;
+            page->bump_offset += slot_size;
+            page->used_count++;
+        }
+
+        if (is_slab_page_full(page)) {
+            remove_slab_page(page);
+        }
+    }
+
+    return count;
+
+}
+
+/**
+ * @brief frees a slab slot, releasing its page to the heap once it is empty
+ * The last partial page of a class is kept, so a class does not churn a page on every allocation.
+ * 
+ * @param page: slab page of the slot
+ * @param ptr: slot
+ * 
+ * @return void
+ */
+static void free_slab_slot(slab_page_t* page, void* ptr)
+{
+
+    bool was_full = is_slab_page_full(page);
+    slab_slot_t* slot = (slab_slot_t *)ptr;
+
+    slot->next = page->free_slot;
+    page->free_slot = slot;
+    page->used_count--;
+
+    if (was_full) {
+        insert_slab_page(page);
+    } else if (page->used_count == 0 && (page->prev != NULL || page->next != NULL)) {
+        remove_slab_page(page);
+        set_slab_map_bit(page, false);
+        heap_ctl->slab_page_count--;
+        release_block(get_header((uint64_t *)page), SLAB_PAGE_SIZE);
+    }
+
+}
+
+/**
+ * @brief reads if a block handed out is a mapped block from header
+ * 
+ * @param ptr: address of the block
+ * 
+ * @return bool: true if the block has a mapping of its own
+ */
+static bool is_mapped_block(uint64_t *ptr) {
+
+    return (read_block(ptr) & MAPPED_BIT) != 0;
+
+}
+
+/**
+ * @brief reads the size of the mapping of a mapped block, from the word at the start of its padding
+ * 
+ * @param header_ptr: address of the mapped block
+ * 
+ * @return uint64_t: the size of the whole mapping
+ */
+static uint64_t get_mapping_size(uint64_t* header_ptr) {
+
+    return *(uint64_t *)((char *)header_ptr - PADDING_SIZE);
+
+}
+
+/**
+ * @brief allocates a block of size bytes in a mapping of its own, outside the heap
+ * The mapping starts with the padding, whose first word is the size of the whole mapping, and the header.
+ * 
+ * @param size: size of the block
+ * 
+ * @return void*: pointer to the payload of the block, NULL if the mapping fails
+ */
+static void* map_block(size_t size)
+{
+
+    uint64_t page_size = (uint64_t)mm_pagesize();
+
+    if (size > SIZE_MAX - PADDING_SIZE - HEADER_SIZE - page_size)
+        return NULL;
+
+    uint64_t mapping_size = (size + PADDING_SIZE + HEADER_SIZE + page_size - 1) & ~(page_size - 1);
+
+#ifdef MM_THREADS
+    pthread_mutex_lock(&map_lock);
+#endif
+    uint64_t* mapping_ptr = (uint64_t *)mm_map(mapping_size);
+#ifdef MM_THREADS
+    pthread_mutex_unlock(&map_lock);
+#endif
+
+    if (mapping_ptr == (void *)-1)
+        return NULL;
+
+    uint64_t* header_ptr = (uint64_t *)((char *)mapping_ptr + PADDING_SIZE);
+    *mapping_ptr = mapping_size; // Mapping size
+    write_block(header_ptr, MAPPED_BIT | 1); // Mapped block header
+
+    return get_block_payload(header_ptr);
+
+}
+
+/**
+ * @brief frees a mapped block, removing its mapping at once
+ * 
+ * @param header_ptr: address of the mapped block
+ * 
+ * @return void
+ */
+static void unmap_block(uint64_t* header_ptr)
+{
+
+#ifdef MM_THREADS
+    pthread_mutex_lock(&map_lock);
+#endif
+    mm_unmap((char *)header_ptr - PADDING_SIZE);
+#ifdef MM_THREADS
+    pthread_mutex_unlock(&map_lock);
+#endif
+
+}
+
+/**
+ * @brief resizes a mapped block by remapping its pages, without copying them
+ * 
+ * @param header_ptr: address of the mapped block
+ * @param size: new size of the block
+ * @param may_move: whether the mapping may move to another address
+ * 
+ * @return void*: pointer to the payload of the resized block, NULL if it cannot be resized and is unchanged
+ */
+static void* remap_block(uint64_t* header_ptr, size_t size, bool may_move)
+{
+
+    uint64_t page_size = (uint64_t)mm_pagesize();
+
+    if (size > SIZE_MAX - PADDING_SIZE - HEADER_SIZE - page_size)
+        return NULL;
+
+    uint64_t mapping_size = (size + PADDING_SIZE + HEADER_SIZE + page_size - 1) & ~(page_size - 1);
+
+    if (mapping_size == get_mapping_size(header_ptr))
+        return get_block_payload(header_ptr);
+
+#ifdef MM_THREADS
+    pthread_mutex_lock(&map_lock);
+#endif
+    uint64_t* mapping_ptr = (uint64_t *)mm_remap((char *)header_ptr - PADDING_SIZE, mapping_size, may_move);
+#ifdef MM_THREADS
+    pthread_mutex_unlock(&map_lock);
+#endif
+
+    if (mapping_ptr == (void *)-1)
+        return NULL;
+
+    header_ptr = (uint64_t *)((char *)mapping_ptr + PADDING_SIZE);
+    *mapping_ptr = mapping_size; // Resized mapping size
+
+    return get_block_payload(header_ptr);
+
+}
+
+/**
+ * @brief pops a free mini block from the mini list and allocates it
+ * 
+ * @return uint64_t*: the allocated mini block, NULL if the mini list is empty
+ */
+static uint64_t* pop_mini_block(void)
+{
+
+    mini_list_node_t* mini_block = heap_ctl->mini_list;
+
+    if (mini_block == NULL) {
+        return NULL;
+    }
+
+    uint64_t* header_ptr = get_header((uint64_t *)mini_block);
+
+    remove_mini_block(header_ptr);
+    write_header(header_ptr, MINI_BLOCK_SIZE, 1);
+    set_prev_allocated(get_next_block(header_ptr), 1);
+
+    return header_ptr;
+
+}
+
+/**
+ * @brief allocates a block from the heap
+ * 
+ * @param size: size of the block
+ * 
+ * @return void*: pointer to the allocated block
+ */
+static void* heap_malloc(size_t size)
+{
+
+    if (size < 1)
+        return NULL;
+
+    uint64_t *free_block_ptr;
+
+    //tiny requests reuse a free mini block left over by a split, if any
+    if (size <= MINI_BLOCK_SIZE - HEADER_SIZE && (free_block_ptr = pop_mini_block()) != NULL){
+        return get_block_payload(free_block_ptr);
+    }
+
+    if (size < 16){
+        size = 16;
+    }
+
+    //small requests take a headerless slot of a slab page, once blocks of their size are common enough to fill pages
+    if (size <= MAX_SLAB_SIZE && count_slab_requests(size, 1)){
+        return allocate_slab_slot(size);
+    }
+
+    //huge requests take a mapping of their own, so they neither fragment the heap nor raise its break
+    if (size > MMAP_THRESHOLD){
+        return map_block(size);
+    }
+
+    uint64_t current_block_size = (uint64_t)align(size + HEADER_SIZE);
+
+    //reuse a block of the same size from the quick lists
+    if (current_block_size <= MAX_QUICK_SIZE && (free_block_ptr = pop_quick_block(current_block_size)) != NULL){
+        return get_block_payload(free_block_ptr);
+    }
+
+    //colored blocks start at rotating offsets within a page, so large blocks carved in a row do not share cache sets
+    if (cache_coloring && size >= COLOR_THRESHOLD) {
+        free_block_ptr = allocate_aligned_block(current_block_size, COLOR_PERIOD, next_color_offset(COLOR_STEP));
+        return free_block_ptr == NULL ? NULL : get_block_payload(free_block_ptr);
+    }
+
+    free_block_ptr = find_free_block(current_block_size);
+    if (free_block_ptr == NULL)
+        return NULL;
+
+    allocate_free_block(free_block_ptr, current_block_size);
+    return get_block_payload(free_block_ptr);
+
+}
+
+/**
+ * @brief allocates a block of zeros from the heap
+ * A block carved from a free block known to be zero only has its free list node, 
+ * and the old footer if the whole block is taken, cleared. Mappings are zero already.
+ * 
+ * @param size: size of the block
+ * 
+ * @return void*: pointer to the allocated block
+ */
+static void* heap_calloc(size_t size)
+{
+
+    if (size < 1)
+        return NULL;
+
+    if (size > MMAP_THRESHOLD){
+        return map_block(size);
+    }
+
+    uint64_t block_size = (uint64_t)align(size + HEADER_SIZE);
+    void* ptr;
+
+    //slots, quick blocks and colored blocks carry no zero mark
+    if (size <= MAX_SLAB_SIZE || block_size <= MAX_QUICK_SIZE || (cache_coloring && size >= COLOR_THRESHOLD)){
+        ptr = heap_malloc(size);
+        if (ptr != NULL) {
+            memset(ptr, 0, size);
+        }
+        return ptr;
+    }
+
+    uint64_t* free_block_ptr = find_free_block(block_size);
+    if (free_block_ptr == NULL)
+        return NULL;
+
+    uint64_t* old_footer_ptr = get_footer(free_block_ptr);
+    ptr = get_block_payload(free_block_ptr);
+
+    if (!allocate_free_block(free_block_ptr, block_size)) {
+        memset(ptr, 0, size);
+        return ptr;
+    }
+
+    memset(ptr, 0, size < sizeof(free_tree_node_t) ? size : sizeof(free_tree_node_t));
+    if ((uint64_t)old_footer_ptr < (uint64_t)ptr + size) {
+        write_block(old_footer_ptr, 0);
+    }
+    return ptr;
+
+}
+
+/**
+ * @brief allocates a block from the heap whose payload is aligned to alignment bytes
+ * Aligned blocks are never slab slots or quick blocks, and have exactly the aligned block size of the request.
+ * 
+ * @param alignment: alignment of the payload, a power of two
+ * @param size: size of the block
+ * 
+ * @return void*: pointer to the allocated block, NULL if alignment is not a power of two or the heap cannot grow
+ */
+static void* heap_memalign(size_t alignment, size_t size)
+{
+
+    if (size < 1 || alignment == 0 || (alignment & (alignment - 1)) != 0 || size > SIZE_MAX - alignment)
+        return NULL;
+
+    //every payload is aligned to ALIGNMENT already
+    if (alignment <= ALIGNMENT)
+        return heap_malloc(size);
+
+    uint64_t block_size = (uint64_t)align(size + HEADER_SIZE);
+    uint64_t* header_ptr;
+
+    //colored blocks keep their alignment, with colors a multiple of it apart
+    if (cache_coloring && size >= COLOR_THRESHOLD && alignment < COLOR_PERIOD) {
+        header_ptr = allocate_aligned_block(block_size, COLOR_PERIOD, next_color_offset(alignment > COLOR_STEP ? alignment : COLOR_STEP));
+    } else {
+        header_ptr = allocate_aligned_block(block_size, alignment, 0);
+    }
+    if (header_ptr == NULL)
+        return NULL;
+
+    return get_block_payload(header_ptr);
+
+}
+
+/**
+ * @brief frees a block with a header, to its quick list or coalesced right away
+ * 
+ * @param header_ptr: address of the block
+ * @param block_size: size of the block
+ * 
+ * @return void
+ */
+static void free_block(uint64_t* header_ptr, uint64_t block_size)
+{
+
+    uncount_slab_block(block_size);
+
+    //small blocks go to the quick lists, and are only coalesced once the quick lists hold too many bytes
+    //mini blocks are coalesced right away, since they only come from leftovers
+    if (block_size <= MAX_QUICK_SIZE && block_size != MINI_BLOCK_SIZE) {
+        push_quick_block(header_ptr, block_size);
+        if (heap_ctl->quick_bytes > QUICK_BYTES_THRESHOLD) {
+            consolidate_quick_lists();
+        }
+        return;
+    }
+
+    release_block(header_ptr, block_size);
+
+}
+
+/**
+ * @brief frees a block back to the heap
+ * 
+ * @param ptr: pointer to the block to be freed
+ * 
+ * @return void
+ */
+static void heap_free(void* ptr)
+{
+
+    if (ptr == NULL)
+        return;
+
+    slab_page_t* page = get_slab_page(ptr);
+    if (page != NULL) {
+        free_slab_slot(page, ptr);
+        return;
+    }
+
+    uint64_t* header_ptr = get_header(ptr);
+
+    if (is_mapped_block(header_ptr)) {
+        unmap_block(header_ptr);
+        return;
+    }
+
+    free_block(header_ptr, get_block_size(header_ptr));
+
+    return;
+
+}
+
+/**
+ * @brief frees a block back to the heap, given the size it was allocated or last reallocated with
+ * Blocks above MAX_SLAB_SIZE are never slab slots and have exactly the aligned block size of the request, 
+ * so neither the slab page nor the size in the header is read, unless the block may be mapped. 
+ * Known limitation: sizes up to MAX_SLAB_SIZE gain nothing, since they may also be mini blocks, blocks 
+ * shrunk in place by realloc or blocks served before their size took slab slots, and take the path of heap_free.
+ * 
+ * @param ptr: pointer to the block to be freed
+ * @param size: size requested for the block
+ * 
+ * @return void
+ */
+static void heap_free_sized(void* ptr, size_t size)
+{
+
+    if (ptr == NULL || size <= MAX_SLAB_SIZE) {
+        dbg_assert(ptr == NULL || get_slab_page(ptr) == NULL || get_slab_page(ptr)->slot_size == align(size < 16 ? 16 : size));
+        heap_free(ptr);
+        return;
+    }
+
+    uint64_t* header_ptr = get_header(ptr);
+    uint64_t block_size = (uint64_t)align(size + HEADER_SIZE);
+
+    //above MMAP_THRESHOLD, a block is mapped unless it is an aligned or batch block
+    if (size > MMAP_THRESHOLD && is_mapped_block(header_ptr)) {
+        unmap_block(header_ptr);
+        return;
+    }
+
+    dbg_assert(get_slab_page(ptr) == NULL && get_block_size(header_ptr) == block_size);
+
+    free_block(header_ptr, block_size);
+
+}
+
+/**
+ * @brief resizes a block of the heap
+ * 
+ * @param oldptr: pointer to the old block
+ * @param size: size of the new block
+ * 
+ * @return void*: pointer to the new block
+ */
+static void* heap_realloc(void* oldptr, size_t size)
+{
+
+    if(oldptr == NULL){
+        return heap_malloc(size);
+    }
+
+    if(size == 0){
+        heap_free(oldptr);
+        return NULL;
+    }
+
+    //a slab slot stays if the size class does not change, and moves otherwise
+    slab_page_t* page = get_slab_page(oldptr);
+    if(page != NULL){
+        if(align(size < 16 ? 16 : size) == page->slot_size){
+            return oldptr;
+        }
+        void* new_ptr = heap_malloc(size);
+        if(new_ptr == NULL){
+            return NULL;
+        }
+        memcpy(new_ptr, oldptr, size < page->slot_size ? size : page->slot_size);
+        heap_free(oldptr);
+        return new_ptr;
+    }
+
+    uint64_t* old_block_ptr = get_header(oldptr);
+    uint64_t old_block_size = get_block_size(old_block_ptr);
+    uint64_t* new_block_ptr;
+
+    //a mapped block is remapped without copying while it stays above MMAP_THRESHOLD, and moves to the heap otherwise
+    if(is_mapped_block(old_block_ptr)){
+        if(size > MMAP_THRESHOLD){
+            return remap_block(old_block_ptr, size, true);
+        }
+        void* new_ptr = heap_malloc(size);
+        if(new_ptr == NULL){
+            return NULL;
+        }
+        memcpy(new_ptr, oldptr, size);
+        unmap_block(old_block_ptr);
+        return new_ptr;
+    }
+
+    //align the size, a payload of up to 8 bytes fits a mini block
+    uint64_t new_block_size = size <= MINI_BLOCK_SIZE - HEADER_SIZE ? MINI_BLOCK_SIZE : (uint64_t)align(size + HEADER_SIZE);
+
+    //if the new size is same as the old size, return the old pointer
+    if(old_block_size == new_block_size){
+        return oldptr;
+    }
+    //a block growing above MMAP_THRESHOLD moves to a mapping, where it grows by remapping from then on
+    else if(old_block_size < new_block_size && size > MMAP_THRESHOLD){
+        void* new_ptr = map_block(size);
+        if(new_ptr == NULL){
+            return NULL;
+        }
+        memcpy(new_ptr, oldptr, old_block_size - HEADER_SIZE);
+        heap_free(oldptr);
+        return new_ptr;
+    }
+    //if the new size is less than the old size, allocate the block, coalesce the freed tail and return the old pointer
+    else if(old_block_size > new_block_size){
+        allocate_block(old_block_ptr, new_block_size);
+        return oldptr;
+    }
+    //if the new size is greater than the old size, grow in place, or merge with a free previous block
+    else if(expand_block_in_place(old_block_ptr, new_block_size)){
+        return oldptr;
+    }
+    else if((new_block_ptr = merge_with_prev_block(old_block_ptr, new_block_size)) != NULL){
+        return get_block_payload(new_block_ptr);
+    }
+    //otherwise allocate a new block and copy the old block to the new block
+    else{
+        new_block_ptr = heap_malloc(size);
+        if(new_block_ptr == NULL){
+            return NULL;
+        }
+        memcpy(new_block_ptr, oldptr, old_block_size - HEADER_SIZE);
+        heap_free(oldptr);
+        return new_block_ptr;
+    }
+    
+    return NULL;
+}
+
+/**
+ * @brief returns the number of bytes usable in a block, the slot size of a slab slot 
+ * or the block size less the header of a block
+ * 
+ * @param ptr: pointer to the block
+ * 
+ * @return size_t: usable size of the block, 0 if ptr is NULL
+ */
+static size_t heap_malloc_usable_size(void* ptr)
+{
+
+    if (ptr == NULL)
+        return 0;
+
+    slab_page_t* page = get_slab_page(ptr);
+    if (page != NULL) {
+        return page->slot_size;
+    }
+
+    //the size of a mapped block is the size of its mapping, which starts with the padding
+    uint64_t* header_ptr = get_header(ptr);
+    if (is_mapped_block(header_ptr)) {
+        return get_mapping_size(header_ptr) - PADDING_SIZE - HEADER_SIZE;
+    }
+
+    return get_block_size(header_ptr) - HEADER_SIZE;
+
+}
+
+/**
+ * @brief grows a block in place, never moving it, to a usable size of up to max_size bytes and at least min_size bytes
+ * The block takes max_size bytes if the free next block is large enough or the block ends the heap, 
+ * and otherwise all of a free next block, if that gives it min_size bytes. Slab slots never grow, 
+ * and mapped blocks grow only if the pages past their mapping are free.
+ * 
+ * @param ptr: pointer to the block
+ * @param min_size: smallest usable size the block has to reach
+ * @param max_size: usable size wanted for the block
+ * 
+ * @return size_t: usable size of the block, less than min_size if it could not grow enough and is unchanged
+ */
+static size_t heap_try_expand(void* ptr, size_t min_size, size_t max_size)
+{
+
+    if (ptr == NULL || get_slab_page(ptr) != NULL)
+        return heap_malloc_usable_size(ptr);
+
+    uint64_t* header_ptr = get_header(ptr);
+
+    //a mapped block grows if the pages past its mapping are free
+    if (is_mapped_block(header_ptr)) {
+        size_t usable_size = heap_malloc_usable_size(ptr);
+        if (usable_size < max_size && (remap_block(header_ptr, max_size, false) != NULL || 
+            (usable_size < min_size && remap_block(header_ptr, min_size, false) != NULL))) {
+            usable_size = heap_malloc_usable_size(ptr);
+        }
+        return usable_size;
+    }
+
+    uint64_t block_size = get_block_size(header_ptr);
+    uint64_t min_block_size = (uint64_t)align(min_size + HEADER_SIZE);
+    uint64_t max_block_size = (uint64_t)align((max_size > min_size ? max_size : min_size) + HEADER_SIZE);
+
+    //never shrink the block
+    if (block_size >= max_block_size)
+        return block_size - HEADER_SIZE;
+
+    if (expand_block_in_place(header_ptr, max_block_size))
+        return max_block_size - HEADER_SIZE;
+
+    //short of max_size, the block can still take the whole free next block
+    uint64_t* next_block_ptr = get_next_block(header_ptr);
+    if (get_is_allocated(next_block_ptr) == 0) {
+        uint64_t available_size = block_size + get_block_size(next_block_ptr);
+        if (available_size >= min_block_size && expand_block_in_place(header_ptr, available_size)) {
+            return available_size - HEADER_SIZE;
+        }
+    }
+
+    return block_size - HEADER_SIZE;
+
+}
+
+/**
+ * @brief allocates n blocks of size bytes, carving the blocks that the quick lists do not hold out of a single fit
+ * 
+ * @param size: size of each block
+ * @param n: number of blocks
+ * @param out: array receiving the pointers to the blocks
+ * 
+ * @return size_t: number of blocks allocated, less than n if the heap cannot grow
+ */
+static size_t heap_malloc_batch(size_t size, size_t n, void** out)
+{
+
+    if (size < 1 || n == 0)
+        return 0;
+
+    if (size < 16){
+        size = 16;
+    }
+
+    if (size <= MAX_SLAB_SIZE && count_slab_requests(size, n)){
+        return allocate_slab_slots(size, n, out);
+    }
+
+    uint64_t block_size = (uint64_t)align(size + HEADER_SIZE);
+    uint64_t* block_ptr;
+    size_t count = 0;
+
+    while (count < n && block_size <= MAX_QUICK_SIZE && (block_ptr = pop_quick_block(block_size)) != NULL){
+        out[count++] = get_block_payload(block_ptr);
+    }
+
+    if (count == n)
+        return count;
+
+    //one fit for the whole run, or one block at a time if the run does not fit
+    uint64_t run_count = n - count;
+    if (run_count > UINT64_MAX / block_size || (block_ptr = find_free_block(run_count * block_size)) == NULL) {
+        while (count < n && (out[count] = heap_malloc(size)) != NULL) {
+            count++;
+        }
+        return count;
+    }
+
+    allocate_free_block(block_ptr, run_count * block_size);
+
+    //the last block keeps the leftover too small to split off, the first keeps the previous bits of the fit
+    uint64_t last_size = get_block_size(block_ptr) - (run_count - 1) * block_size;
+    for (uint64_t i = 0; i < run_count; i++) {
+        uint64_t current_size = i == run_count - 1 ? last_size : block_size;
+        if (i == 0) {
+            write_header(block_ptr, current_size, 1);
+        } else {
+            write_block(block_ptr, packHeader(current_size, 1, 1));
+        }
+        out[count++] = get_block_payload(block_ptr);
+        block_ptr += current_size / UINT64_T_SIZE;
+    }
+
+    return count;
+
+}
+
+/**
+ * @brief orders pointers by address, for qsort
+ * 
+ * @param a: first pointer
+ * @param b: second pointer
+ * 
+ * @return int: negative, zero or positive as a is below, at or above b
+ */
+static int compare_pointers(const void* a, const void* b)
+{
+
+    uintptr_t x = (uintptr_t)*(void* const*)a;
+    uintptr_t y = (uintptr_t)*(void* const*)b;
+
+    return x < y ? -1 : x > y;
+
+}
+
+/**
+ * @brief sorts pointers by address, by insertion for the short batches, where qsort costs more than it saves
+ * 
+ * @param ptrs: pointers to sort
+ * @param n: number of pointers
+ * 
+ * @return void
+ */
+static void sort_pointers(void** ptrs, size_t n)
+{
+
+    if (n > INSERTION_SORT_LIMIT) {
+        qsort(ptrs, n, sizeof(void*), compare_pointers);
+        return;
+    }
+
+    for (size_t i = 1; i < n; i++) {
+        void* ptr = ptrs[i];
+        size_t j = i;
+        while (j > 0 && (uintptr_t)ptrs[j - 1] > (uintptr_t)ptr) {
+            ptrs[j] = ptrs[j - 1];
+            j--;
+        }
+        ptrs[j] = ptr;
+    }
+
+}
+
+/**
+ * @brief frees n blocks: slab slots and mapped blocks right away, then the other blocks sorted by address, 
+ * freeing each run of adjacent blocks as one block
+ * 
+ * @param ptrs: pointers to the blocks, reordered, NULL entries are skipped
+ * @param n: number of pointers
+ * 
+ * @return void
+ */
+static void heap_free_batch(void** ptrs, size_t n)
+{
+
+    //slab slots and mapped blocks gain nothing from sorting, the heap blocks with a header are moved to the front
+    size_t block_count = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (ptrs[i] == NULL) {
+            continue;
+        }
+        slab_page_t* page = get_slab_page(ptrs[i]);
+        if (page != NULL) {
+            free_slab_slot(page, ptrs[i]);
+        } else if (is_mapped_block(get_header(ptrs[i]))) {
+            unmap_block(get_header(ptrs[i]));
+        } else {
+            ptrs[block_count++] = ptrs[i];
+        }
+    }
+    n = block_count;
+
+    sort_pointers(ptrs, n);
+
+    size_t i = 0;
+    while (i < n) {
+
+        //extend the run while the next pointer is the payload of the next block
+        uint64_t* header_ptr = get_header(ptrs[i]);
+        uint64_t* end_ptr = get_next_block(header_ptr);
+        size_t run_end = i + 1;
+        while (run_end < n && ptrs[run_end] == (void *)get_block_payload(end_ptr)) {
+            end_ptr = get_next_block(end_ptr);
+            run_end++;
+        }
+
+        if (run_end - i == 1) {
+            heap_free(ptrs[i]);
+        } else {
+            //every block of the run leaves the live counts of the slab warm-up, as free_block does for one block
+            for (uint64_t* block_ptr = header_ptr; block_ptr != end_ptr; block_ptr = get_next_block(block_ptr)) {
+                uncount_slab_block(get_block_size(block_ptr));
+            }
+
+            uint64_t run_size = (uint64_t)((char *)end_ptr - (char *)header_ptr);
+            write_header(header_ptr, run_size, 1);
+            release_block(header_ptr, run_size);
+        }
+        i = run_end;
+    }
+
+}
+
+/**
+ * @brief creates an empty heap, with its control block at its start, in a region of the reserved space
+ * 
+ * @param region: region the heap grows in, 0 for the heap of mem_sbrk
+ * 
+ * @return heap_ctl_t*: the control block of the heap, NULL on error
+ */
+static heap_ctl_t* create_heap(int region)
+{
+
+#ifdef MM_THREADS
+    heap_ctl_t* ctl = (heap_ctl_t *)mm_region_sbrk(region, align(sizeof(heap_ctl_t)) + PADDING_SIZE + PROLOGUE_SIZE + EPILOGUE_SIZE);
+#else
+    heap_ctl_t* ctl = (heap_ctl_t *)mem_sbrk(align(sizeof(heap_ctl_t)) + PADDING_SIZE + PROLOGUE_SIZE + EPILOGUE_SIZE);
+#endif
+
+    if (ctl == (void *)-1)
+        return NULL;
+
+    ctl->region = region;
+#ifdef MM_THREADS
+    pthread_mutex_init(&ctl->lock, NULL);
+    ctl->remote_free = NULL;
+#endif
+    ctl->fl_bitmap = 0;
+    for (int i = 0; i < FL_INDEX_COUNT; i++) {
+        ctl->sl_bitmap[i] = 0;
+    }
+    for (int i = 0; i < FREE_LIST_COUNT; i++) {
+        ctl->free_list[i].head = NULL;
+        ctl->list_max[i] = 0;
+    }
+    ctl->large_tree = NULL;
+    ctl->dirty_blocks = NULL;
+    ctl->wilderness = NULL;
+    ctl->grow_size = MIN_GROW_SIZE;
+    ctl->carve_count = 0;
+    for (int i = 0; i < QUICK_LIST_COUNT; i++) {
+        ctl->quick_list[i] = NULL;
+    }
+    ctl->quick_bytes = 0;
+    ctl->mini_list = NULL;
+    for (int i = 0; i < SLAB_CLASS_COUNT; i++) {
+        ctl->slab_partial[i] = NULL;
+    }
+    ctl->slab_page_count = 0;
+    ctl->slab_map = NULL;
+    ctl->slab_warm = 0;
+    for (int i = 0; i < SLAB_CLASS_COUNT; i++) {
+        ctl->slab_live[i] = 0;
+    }
+    ctl->dirty_bytes = 0;
+    ctl->decay_epoch = get_time_ns();
+    for (int i = 0; i < DECAY_STEPS; i++) {
+        ctl->decay_backlog[i] = 0;
+    }
+    ctl->next_color = 0;
+#ifdef MM_FIT_STATS
+    ctl->fit_node_count = 0;
+#endif
+#ifdef MM_CACHE_MODEL
+    for (int i = 0; i < CACHE_MODEL_SETS; i++) {
+        for (int j = 0; j < CACHE_MODEL_WAYS; j++) {
+            ctl->cache_tags[i][j] = 0;
+        }
+    }
+    ctl->cache_access_count = 0;
+    ctl->cache_miss_count = 0;
+#endif
+
+    uint64_t* prologue_ptr = (uint64_t *)((char *)ctl + align(sizeof(heap_ctl_t)));
+
+    write_block(prologue_ptr, 0); // Alignment padding
+    prologue_ptr = (uint64_t *)((char *)prologue_ptr + PADDING_SIZE);
+    write_block(prologue_ptr, packHeader(PROLOGUE_SIZE, 1, 0)); // Prologue header
+    write_block((uint64_t *)((char *)prologue_ptr + PROLOGUE_SIZE - FOOTER_SIZE), packFooter(PROLOGUE_SIZE, 1)); // Prologue footer
+    write_block(prologue_ptr + (PROLOGUE_SIZE/UINT64_T_SIZE), packHeader(0, 1, 1)); // Epilogue header
+
+    ctl->prologue_ptr = prologue_ptr;
+    ctl->epilogue_ptr = ctl->prologue_ptr + (PROLOGUE_SIZE/UINT64_T_SIZE);
+
+    return ctl;
+
+}
+
+#ifdef MM_THREADS
+
+/*
+ * Thread-safe build (-DMM_THREADS)
+ * 
+ * The memory is split into ARENA_COUNT arenas, each a complete heap with its own lock, growing in its own region 
+ * of the reserved space. Arena 0 is created by mm_init and the others on first use. Threads are assigned to arenas 
+ * round robin, and a thread that finds the lock of its arena taken on CONTENTION_LIMIT of CONTENTION_WINDOW 
+ * acquisitions moves on to the next arena. A block belongs to the arena of the region its address lies in, 
+ * so a free from any thread goes back to the right heap.
+ * 
+ * In front of the arenas, every thread keeps a cache (tcache) of free slab slots per slab class. malloc and free 
+ * of small blocks pop and push the cache of the thread without any lock or atomic operation, and only lock an arena 
+ * to refill an empty bin or flush a full one, TCACHE_BATCH slots at a time. Larger blocks and realloc lock an arena 
+ * for the whole call. The cached slots stay allocated in their slab pages, and are flushed back when the thread exits.
+ * 
+ * A thread does not lock another arena to free its blocks. It pushes them onto the remote free stack of the arena 
+ * instead, a lock-free multiple producer stack updated with a single CAS per block, or per run of slots of one arena 
+ * when flushing a tcache bin. The next thread to allocate from the arena under its lock takes the whole stack with 
+ * one atomic exchange and frees the blocks through the normal free and coalescing path. Setting the environment 
+ * variable MM_REMOTE_FREE=0 before mm_init makes remote frees lock the owning arena instead.
+ * 
+ * With MM_ASYNC_FREE=1, free of a block outside the slab pages only pushes it onto a global async free queue, 
+ * a lock-free stack like the remote free stacks, and returns. A background maintenance thread, started by the first 
+ * queued free, takes the whole queue at once and frees the blocks under the lock of their arenas. When the queue 
+ * is idle it does the housekeeping of the arenas every MAINTENANCE_INTERVAL_MS: it drains their remote free stacks 
+ * and consolidates their quick lists, skipping an arena whose lock is taken. Once ASYNC_FREE_LIMIT blocks are 
+ * pending, free falls back to freeing synchronously until the thread catches up. mm_init and mm_quiesce stop the 
+ * thread.
+ * 
+ * While a thread holds the lock of an arena, heap_ctl (thread local) points to the arena, so the heap code above 
+ * works on it unchanged.
+ */
+
+#define TCACHE_BIN_SIZE 32          // most slots a thread caches per slab class
+#define TCACHE_BATCH 16             // slots moved between a bin and the heap at once
+
+#define CONTENTION_WINDOW 64        // arena lock acquisitions per contention sample
+#define CONTENTION_LIMIT 16         // contended acquisitions in a window that move a thread to the next arena
+
+#define ASYNC_FREE_LIMIT 4096       // queued frees above which free is done synchronously
+#define MAINTENANCE_SPINS 64        // empty polls of the async free queue before the maintenance thread sleeps
+#define MAINTENANCE_INTERVAL_MS 10  // housekeeping period of the maintenance thread
+
+/*
+ * structure of a block in the remote free stack of an arena, linked through its payload
+ */
+typedef struct remote_free_node {
+    struct remote_free_node* next;
+} remote_free_node_t;
+
+/*
+ * structure of the per-thread cache, a LIFO list of free slots per slab class
+ */
+typedef struct tcache {
+    slab_slot_t* bin[SLAB_CLASS_COUNT];
+    uint32_t count[SLAB_CLASS_COUNT];
+    bool registered;            // the exit destructor is set for the thread
+} tcache_t;
+
+pthread_mutex_t arena_create_lock = PTHREAD_MUTEX_INITIALIZER;
+uint32_t next_arena;                // round robin counter of the thread to arena assignment
+bool remote_free_enabled;           // frees of other arenas go to their remote free stacks
+pthread_once_t tcache_key_once = PTHREAD_ONCE_INIT;
+pthread_key_t tcache_key;
+static __thread tcache_t tcache;
+static __thread int thread_arena = -1;
+static __thread uint32_t lock_count;
+static __thread uint32_t contended_count;
+
+bool async_free_enabled;            // free queues blocks for the maintenance thread
+void* async_free_queue;             // lock-free stack of blocks to be freed by the maintenance thread
+uint32_t async_free_pending;        // blocks queued and not yet freed
+pthread_t maintenance_thread;
+pthread_mutex_t maintenance_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t maintenance_cond = PTHREAD_COND_INITIALIZER;
+bool maintenance_running;           // the thread is started, set under maintenance_lock
+bool maintenance_sleeping;          // the thread waits on maintenance_cond and must be woken
+bool maintenance_stop;              // asks the thread to exit
+
+/**
+ * @brief returns an arena, creating it on first use
+ * 
+ * @param index: index of the arena
+ * 
+ * @return heap_ctl_t*: the arena, arena 0 if it cannot be created
+ */
+static heap_ctl_t* get_arena(int index)
+{
+
+    heap_ctl_t* arena = __atomic_load_n(&arenas[index], __ATOMIC_ACQUIRE);
+
+    if (arena == NULL) {
+        pthread_mutex_lock(&arena_create_lock);
+        arena = arenas[index];
+        if (arena == NULL && (arena = create_heap(index)) != NULL) {
+            __atomic_store_n(&arenas[index], arena, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&arena_create_lock);
+    }
+
+    return arena != NULL ? arena : arenas[0];
+
+}
+
+/**
+ * @brief returns the arena a block belongs to, from the region its address lies in
+ * 
+ * @param ptr: payload pointer
+ * 
+ * @return heap_ctl_t*: the arena of the block
+ */
+static heap_ctl_t* get_block_arena(void* ptr)
+{
+    return __atomic_load_n(&arenas[mm_region_of(ptr)], __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief returns the arena of the calling thread, assigning one round robin on first use
+ * 
+ * @return heap_ctl_t*: the arena of the thread
+ */
+static heap_ctl_t* get_thread_arena(void)
+{
+
+    if (thread_arena < 0) {
+        thread_arena = (int)(__atomic_fetch_add(&next_arena, 1, __ATOMIC_RELAXED) % ARENA_COUNT);
+    }
+
+    return get_arena(thread_arena);
+
+}
+
+/**
+ * @brief locks an arena and makes it the heap of the thread, 
+ * moving the thread to the next arena if its locks were contended for a whole window
+ * 
+ * @param arena: arena to lock
+ * 
+ * @return void
+ */
+static void lock_arena(heap_ctl_t* arena)
+{
+
+    if (pthread_mutex_trylock(&arena->lock) != 0) {
+        contended_count++;
+        pthread_mutex_lock(&arena->lock);
+    }
+    heap_ctl = arena;
+
+    if (++lock_count == CONTENTION_WINDOW) {
+        if (contended_count >= CONTENTION_LIMIT && thread_arena >= 0) {
+            thread_arena = (thread_arena + 1) % ARENA_COUNT;
+        }
+        lock_count = 0;
+        contended_count = 0;
+    }
+
+}
+
+/**
+ * @brief unlocks the arena locked by the thread
+ * 
+ * @return void
+ */
+static void unlock_arena(void)
+{
+    pthread_mutex_unlock(&heap_ctl->lock);
+}
+
+/**
+ * @brief returns whether a block of an arena is freed remotely, that is the arena is not the one of the thread
+ * 
+ * @param arena: arena of the block
+ * 
+ * @return bool: true if the block goes to the remote free stack of its arena
+ */
+static bool is_remote_arena(heap_ctl_t* arena)
+{
+    return remote_free_enabled && (thread_arena < 0 || arena != arenas[thread_arena]);
+}
+
+/**
+ * @brief pushes a chain of blocks onto a lock-free free stack with a single CAS
+ * 
+ * @param stack: remote free stack of an arena, or the async free queue
+ * @param first: first block of the chain
+ * @param last: last block of the chain, whose link is overwritten
+ * 
+ * @return void
+ */
+static void push_free_stack(void** stack, remote_free_node_t* first, remote_free_node_t* last)
+{
+
+    remote_free_node_t* head = __atomic_load_n((remote_free_node_t**)stack, __ATOMIC_RELAXED);
+
+    do {
+        last->next = head;
+    } while (!__atomic_compare_exchange_n((remote_free_node_t**)stack, &head, first, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+}
+
+/**
+ * @brief frees the blocks of the remote free stack of the arena locked by the thread
+ * 
+ * @return void
+ */
+static void drain_remote_frees(void)
+{
+
+    if (__atomic_load_n((remote_free_node_t**)&heap_ctl->remote_free, __ATOMIC_RELAXED) == NULL) {
+        return;
+    }
+
+    remote_free_node_t* node = __atomic_exchange_n((remote_free_node_t**)&heap_ctl->remote_free, NULL, __ATOMIC_ACQUIRE);
+
+    while (node != NULL) {
+        remote_free_node_t* next = node->next;
+        heap_free(node);
+        node = next;
+    }
+
+}
+
+/**
+ * @brief sets the destructor that flushes the cache of the thread when it exits, once per thread
+ * 
+ * @return void
+ */
+static void register_tcache(void)
+{
+
+    if (!tcache.registered) {
+        pthread_setspecific(tcache_key, &tcache);
+        tcache.registered = true;
+    }
+
+}
+
+/**
+ * @brief frees every block of the async free queue, locking each arena once per run of its blocks
+ * 
+ * @return uint32_t: number of blocks freed
+ */
+static uint32_t drain_async_frees(void)
+{
+
+    remote_free_node_t* node = __atomic_exchange_n((remote_free_node_t**)&async_free_queue, NULL, __ATOMIC_ACQUIRE);
+    heap_ctl_t* locked_arena = NULL;
+    uint32_t count = 0;
+
+    while (node != NULL) {
+        remote_free_node_t* next = node->next;
+        heap_ctl_t* arena = get_block_arena(node);
+        if (arena != locked_arena) {
+            if (locked_arena != NULL) {
+                unlock_arena();
+            }
+            lock_arena(arena);
+            locked_arena = arena;
+        }
+        heap_free(node);
+        node = next;
+        count++;
+    }
+    if (locked_arena != NULL) {
+        unlock_arena();
+    }
+
+    if (count > 0) {
+        __atomic_fetch_sub(&async_free_pending, count, __ATOMIC_RELEASE);
+    }
+    return count;
+
+}
+
+/**
+ * @brief housekeeping of the arenas whose lock is free: drains their remote free stacks, 
+ * consolidates their quick lists and gives back the memory whose decay time has passed
+ * 
+ * @return void
+ */
+static void maintain_arenas(void)
+{
+
+    for (int i = 0; i < ARENA_COUNT; i++) {
+        heap_ctl_t* arena = __atomic_load_n(&arenas[i], __ATOMIC_ACQUIRE);
+        if (arena == NULL || pthread_mutex_trylock(&arena->lock) != 0) {
+            continue;
+        }
+        heap_ctl = arena;
+        drain_remote_frees();
+        if (heap_ctl->quick_bytes > 0) {
+            consolidate_quick_lists();
+        }
+        decay_dirty_memory(0);
+        unlock_arena();
+    }
+
+}
+
+/**
+ * @brief body of the maintenance thread: frees the queued blocks as they come, 
+ * and does the housekeeping of the arenas while the queue is idle
+ * 
+ * @param arg: unused
+ * 
+ * @return void*: NULL
+ */
+static void* run_maintenance(void* arg)
+{
 
-            }
+    uint32_t idle_polls = 0;
 
-            current_block_ptr = current_block_ptr->next;
+    while (!__atomic_load_n(&maintenance_stop, __ATOMIC_ACQUIRE)) {
+        if (drain_async_frees() > 0) {
+            idle_polls = 0;
+            continue;
+        }
+        if (++idle_polls < MAINTENANCE_SPINS) {
+            sched_yield();
+            continue;
+        }
+        idle_polls = 0;
 
-        } while (current_block_ptr != free_list[i].head);
+        maintain_arenas();
 
-        if(best_free_block_ptr != NULL && i == index){
-            remove_free_block(best_free_block_ptr, best_index);
-            return get_header((uint64_t *)best_free_block_ptr);
+        //sleep until a free is queued or the next housekeeping, a free seeing maintenance_sleeping set wakes the thread
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += MAINTENANCE_INTERVAL_MS * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
         }
-        
+        pthread_mutex_lock(&maintenance_lock);
+        __atomic_store_n(&maintenance_sleeping, true, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&async_free_queue, __ATOMIC_SEQ_CST) == NULL && !maintenance_stop) {
+            pthread_cond_timedwait(&maintenance_cond, &maintenance_lock, &deadline);
+        }
+        __atomic_store_n(&maintenance_sleeping, false, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&maintenance_lock);
     }
-    
+
     return NULL;
+
+}
+
+/**
+ * @brief starts the maintenance thread if it is not running
+ * 
+ * @return bool: true if the thread runs, false if it cannot be created
+ */
+static bool start_maintenance(void)
+{
+
+    if (__atomic_load_n(&maintenance_running, __ATOMIC_ACQUIRE)) {
+        return true;
+    }
+
+    pthread_mutex_lock(&maintenance_lock);
+    if (!maintenance_running) {
+        maintenance_stop = false;
+        if (pthread_create(&maintenance_thread, NULL, run_maintenance, NULL) == 0) {
+            __atomic_store_n(&maintenance_running, true, __ATOMIC_RELEASE);
+        }
+    }
+    pthread_mutex_unlock(&maintenance_lock);
+
+    return maintenance_running;
+
+}
+
+/**
+ * @brief stops the maintenance thread and waits for it to exit, the queued frees stay queued
+ * 
+ * @return void
+ */
+static void stop_maintenance(void)
+{
+
+    pthread_mutex_lock(&maintenance_lock);
+    if (!maintenance_running) {
+        pthread_mutex_unlock(&maintenance_lock);
+        return;
+    }
+    __atomic_store_n(&maintenance_stop, true, __ATOMIC_RELEASE);
+    pthread_cond_signal(&maintenance_cond);
+    pthread_mutex_unlock(&maintenance_lock);
+
+    pthread_join(maintenance_thread, NULL);
+    __atomic_store_n(&maintenance_running, false, __ATOMIC_RELEASE);
+
+}
+
+/**
+ * @brief queues a chain of blocks for the maintenance thread, unless the queue is backed up
+ * 
+ * @param first: first block of the chain
+ * @param last: last block of the chain, whose link is overwritten
+ * @param count: number of blocks in the chain
+ * 
+ * @return bool: true if the blocks are queued, false if they must be freed synchronously
+ */
+static bool queue_async_frees(remote_free_node_t* first, remote_free_node_t* last, uint32_t count)
+{
+
+    if (__atomic_load_n(&async_free_pending, __ATOMIC_RELAXED) >= ASYNC_FREE_LIMIT || !start_maintenance()) {
+        return false;
+    }
+
+    __atomic_fetch_add(&async_free_pending, count, __ATOMIC_RELAXED);
+    push_free_stack(&async_free_queue, first, last);
+
+    //pairs with the check of the queue by the maintenance thread after it sets maintenance_sleeping
+    if (__atomic_load_n(&maintenance_sleeping, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&maintenance_lock);
+        pthread_cond_signal(&maintenance_cond);
+        pthread_mutex_unlock(&maintenance_lock);
+    }
+
+    return true;
+
+}
+
+/**
+ * @brief frees count slots of a bin of the thread cache back to their arenas
+ * Consecutive slots of the same arena are freed under one lock, or pushed to its remote free stack with one CAS.
+ * With async frees, the slots are queued for the maintenance thread at once, still linked as in the bin.
+ * 
+ * @param index: slab class of the bin
+ * @param count: number of slots to free, at most the number of slots in the bin
+ * 
+ * @return void
+ */
+static void flush_tcache_bin(int index, uint32_t count)
+{
+
+    heap_ctl_t* locked_arena = NULL;
+    heap_ctl_t* remote_arena = NULL;
+    remote_free_node_t* remote_first = NULL;
+    remote_free_node_t* remote_last = NULL;
+
+    if (async_free_enabled && count > 0) {
+        slab_slot_t* last = tcache.bin[index];
+        for (uint32_t i = 1; i < count; i++) {
+            last = last->next;
+        }
+        slab_slot_t* rest = last->next;
+        if (queue_async_frees((remote_free_node_t *)tcache.bin[index], (remote_free_node_t *)last, count)) {
+            tcache.bin[index] = rest;
+            tcache.count[index] -= count;
+            return;
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        slab_slot_t* slot = tcache.bin[index];
+        heap_ctl_t* arena = get_block_arena(slot);
+        tcache.bin[index] = slot->next;
+
+        if (is_remote_arena(arena)) {
+            if (arena != remote_arena) {
+                if (remote_arena != NULL) {
+                    push_free_stack(&remote_arena->remote_free, remote_first, remote_last);
+                }
+                remote_arena = arena;
+                remote_first = NULL;
+                remote_last = (remote_free_node_t *)slot;
+            }
+            ((remote_free_node_t *)slot)->next = remote_first;
+            remote_first = (remote_free_node_t *)slot;
+            continue;
+        }
+
+        if (arena != locked_arena) {
+            if (locked_arena != NULL) {
+                unlock_arena();
+            }
+            lock_arena(arena);
+            locked_arena = arena;
+        }
+        free_slab_slot(get_slab_page(slot), slot);
+    }
+    if (remote_arena != NULL) {
+        push_free_stack(&remote_arena->remote_free, remote_first, remote_last);
+    }
+    if (locked_arena != NULL) {
+        unlock_arena();
+    }
+    tcache.count[index] -= count;
+
+}
+
+/**
+ * @brief flushes the whole cache of an exiting thread back to the heap
+ * 
+ * @param arg: the thread cache, unused since the thread local variable is still valid
+ * 
+ * @return void
+ */
+static void flush_tcache(void* arg)
+{
+
+    for (int i = 0; i < SLAB_CLASS_COUNT; i++) {
+        flush_tcache_bin(i, tcache.count[i]);
+    }
+
+}
+
+/**
+ * @brief creates the key whose destructor flushes the cache of an exiting thread
+ * 
+ * @return void
+ */
+static void create_tcache_key(void)
+{
+    pthread_key_create(&tcache_key, flush_tcache);
+}
+
+/**
+ * @brief refills an empty bin of the thread cache with TCACHE_BATCH slots of the arena of the thread
+ * 
+ * @param index: slab class of the bin
+ * 
+ * @return void
+ */
+static void refill_tcache_bin(int index)
+{
+
+    register_tcache();
+
+    lock_arena(get_thread_arena());
+    drain_remote_frees();
+    for (int i = 0; i < TCACHE_BATCH; i++) {
+        slab_slot_t* slot = (slab_slot_t *)allocate_slab_slot((uint64_t)(index + 1) * ALIGNMENT);
+        if (slot == NULL) {
+            break;
+        }
+        slot->next = tcache.bin[index];
+        tcache.bin[index] = slot;
+        tcache.count[index]++;
+    }
+    unlock_arena();
+
+}
+
+/**
+ * @brief allocates a block, from the thread cache for small requests
+ * 
+ * @param size: size of the block
+ * 
+ * @return void*: pointer to the allocated block
+ */
+static void* tcache_malloc(size_t size)
+{
+
+    if (size >= 1 && size <= MAX_SLAB_SIZE) {
+        int index = (int)(align(size) / ALIGNMENT) - 1;
+        if (tcache.bin[index] == NULL) {
+            refill_tcache_bin(index);
+            if (tcache.bin[index] == NULL) {
+                return NULL;
+            }
+        }
+        slab_slot_t* slot = tcache.bin[index];
+        tcache.bin[index] = slot->next;
+        tcache.count[index]--;
+        return slot;
+    }
+
+    //huge blocks take no arena lock
+    if (size > MMAP_THRESHOLD) {
+        return map_block(size);
+    }
+
+    lock_arena(get_thread_arena());
+    drain_remote_frees();
+    void* ptr = heap_malloc(size);
+    unlock_arena();
+
+    return ptr;
+
+}
+
+/**
+ * @brief frees a block that is not a slab slot, sized if its size is known, unmapping it if it is mapped
+ * 
+ * @param ptr: pointer to the block to be freed
+ * @param size: size requested for the block, 0 if unknown
+ * 
+ * @return void
+ */
+static void tcache_free_block(void* ptr, size_t size)
+{
+
+    //a mapped block belongs to no arena and is unmapped at once
+    if (is_mapped_block(get_header(ptr))) {
+        unmap_block(get_header(ptr));
+        return;
+    }
+
+    if (async_free_enabled && queue_async_frees((remote_free_node_t *)ptr, (remote_free_node_t *)ptr, 1)) {
+        return;
+    }
+
+    heap_ctl_t* arena = get_block_arena(ptr);
+    if (is_remote_arena(arena)) {
+        push_free_stack(&arena->remote_free, (remote_free_node_t *)ptr, (remote_free_node_t *)ptr);
+        return;
+    }
+
+    lock_arena(arena);
+    if (size == 0) {
+        heap_free(ptr);
+    } else {
+        heap_free_sized(ptr, size);
+    }
+    unlock_arena();
+
+}
+
+/**
+ * @brief frees a block, to the thread cache for slab slots
+ * 
+ * @param ptr: pointer to the block to be freed
+ * 
+ * @return void
+ */
+static void tcache_free(void* ptr)
+{
+
+    if (ptr == NULL)
+        return;
+
+    //the page of a slot cannot go away while the slot is allocated, so it can be read without the lock
+    //the probe only reads the slab page map of the arena, whose bit for the page cannot change while ptr is allocated
+    slab_page_t* page = get_slab_page(ptr);
+    if (page != NULL) {
+        int index = (int)(page->slot_size / ALIGNMENT) - 1;
+        if (tcache.count[index] == TCACHE_BIN_SIZE) {
+            flush_tcache_bin(index, TCACHE_BATCH);
+        }
+        register_tcache();
+        slab_slot_t* slot = (slab_slot_t *)ptr;
+        slot->next = tcache.bin[index];
+        tcache.bin[index] = slot;
+        tcache.count[index]++;
+        return;
+    }
+
+    tcache_free_block(ptr, 0);
+
+}
+
+/**
+ * @brief frees every queued block and stops the maintenance thread, 
+ * which starts again with the next queued free
+ * 
+ * @return void
+ */
+void mm_quiesce(void)
+{
+
+    stop_maintenance();
+    drain_async_frees();
+
+}
+
+#endif // MM_THREADS
+
+/**
+ * @brief initialises the heap
+ * 
+ * @return bool: true on success, false on error
+ */
+bool mm_init(void)
+{
+    // IMPLEMENT THIS
+
+#ifdef MM_THREADS
+    //the queued blocks belong to the old heap
+    stop_maintenance();
+    async_free_queue = NULL;
+    async_free_pending = 0;
+#endif
+
+    const char* decay = getenv("MM_DECAY_MS");
+    decay_ms = decay == NULL ? DECAY_MS : atoll(decay);
+
+    const char* coloring = getenv("MM_COLORING");
+    cache_coloring = coloring != NULL && atoi(coloring) != 0;
+
+    //huge pages only pay off where the kernel takes the advice
+    const char* huge_pages = getenv("MM_HUGEPAGES");
+    bool want_huge_pages = huge_pages != NULL && atoi(huge_pages) != 0;
+    huge_page_size = mm_advise_huge(want_huge_pages) == 0 && want_huge_pages ? mm_hugepagesize() : 0;
+
+    heap_ctl = create_heap(0);
+
+    if (heap_ctl == NULL)
+        return false;
+
+#ifdef MM_THREADS
+    const char* remote_free = getenv("MM_REMOTE_FREE");
+    remote_free_enabled = remote_free == NULL || atoi(remote_free) != 0;
+    const char* async_free = getenv("MM_ASYNC_FREE");
+    async_free_enabled = async_free != NULL && atoi(async_free) != 0;
+
+    //the other arenas are created again on first use, in their reset regions
+    arenas[0] = heap_ctl;
+    for (int i = 1; i < ARENA_COUNT; i++) {
+        arenas[i] = NULL;
+    }
+
+    //the cache of the initialising thread points into the old heap, other threads must not have cached slots
+    pthread_once(&tcache_key_once, create_tcache_key);
+    for (int i = 0; i < SLAB_CLASS_COUNT; i++) {
+        tcache.bin[i] = NULL;
+        tcache.count[i] = 0;
+    }
+#endif
+
+    return true;
+}
+
+/**
+ * @brief malloc
+ * 
+ * @param size: size of the block
+ * 
+ * @return void*: pointer to the allocated block
+ */
+void* malloc(size_t size)
+{
+#ifdef MM_THREADS
+    return tcache_malloc(size);
+#else
+    return heap_malloc(size);
+#endif
+}
+
+/**
+ * @brief free
+ * 
+ * @param ptr: pointer to the block to be freed
+ * 
+ * @return void
+ */
+void free(void* ptr)
+{
+#ifdef MM_THREADS
+    tcache_free(ptr);
+#else
+    heap_free(ptr);
+#endif
+}
+
+/**
+ * @brief free of a block whose size the caller knows
+ * 
+ * @param ptr: pointer to the block to be freed
+ * @param size: size the block was allocated, or last reallocated, with
+ * 
+ * @return void
+ */
+void free_sized(void* ptr, size_t size)
+{
+#ifdef MM_THREADS
+    //only blocks above the slab sizes are known not to be slab slots
+    if (ptr != NULL && size > MAX_SLAB_SIZE) {
+        tcache_free_block(ptr, size);
+    } else {
+        tcache_free(ptr);
+    }
+#else
+    heap_free_sized(ptr, size);
+#endif
+}
+
+/**
+ * @brief realloc
+ * 
+ * @param oldptr: pointer to the old block
+ * @param size: size of the new block
+ * 
+ * @return void*: pointer to the new block
+ */
+void* realloc(void* oldptr, size_t size)
+{
+#ifdef MM_THREADS
+    //the block is resized, or moved, within its own arena, and a mapped block by the arena of the thread
+    if (oldptr == NULL) {
+        return tcache_malloc(size);
+    }
+    lock_arena(get_slab_page(oldptr) == NULL && is_mapped_block(get_header(oldptr)) ? get_thread_arena() : get_block_arena(oldptr));
+    void* ptr = heap_realloc(oldptr, size);
+    unlock_arena();
+    return ptr;
+#else
+    return heap_realloc(oldptr, size);
+#endif
 }
 
 /**
- * @brief allocates a block of size size
+ * @brief calloc
  * 
- * @param ptr: address of the block
- * @param size: size of the block
+ * @param nmemb: number of elements
+ * @param size: size of each element
  * 
- * @return void
+ * @return void*: pointer to the allocated block, NULL if nmemb * size overflows
  */
-static void allocate_block(uint64_t *ptr, uint64_t size) {
-
-    uint64_t block_size = get_block_size(ptr);
-
-    if (block_size - size > (HEADER_SIZE + FOOTER_SIZE)) {
-
-        //divided allocated block memory and remaining free memory
-
-        write_block(ptr, packHeader(size, 1, get_is_prev_allocated(ptr))); // New allocated block header
-
-        uint64_t* new_free_block = get_next_block(ptr);
-        write_block(new_free_block, packHeader(block_size - size, 0, 1)); // New free block header
-        write_block(get_footer(new_free_block), packFooter(block_size - size, 0)); // New free block footer
-
-        uint64_t* next_block_ptr = get_next_block(new_free_block);
-        uint64_t next_block_size = get_block_size(next_block_ptr);
-        uint64_t is_next_allocated = get_is_allocated(next_block_ptr);
-
-        write_block(next_block_ptr, packHeader(next_block_size, is_next_allocated, 0)); // update header of next block with previous allocated bit
-
-        free_list_node_t* new_free_block_payload = (free_list_node_t*)get_block_payload(new_free_block);
-        int index = get_list_index(block_size - size);
-        insert_free_block(new_free_block_payload, index);
-        write_block(get_block_payload(new_free_block), *((uint64_t *) new_free_block_payload)); // set the payload to the free list node
-
-    } else {
-        //allocated all the remaining memory to the allocated block
-
-        write_block(ptr, packHeader(block_size, 1, get_is_prev_allocated(ptr))); // New allocated block header
-
-        uint64_t* next_block_ptr = get_next_block(ptr);
-        uint64_t next_block_size = get_block_size(next_block_ptr);
-        uint64_t is_next_allocated = get_is_allocated(next_block_ptr);
-
-        write_block(next_block_ptr, packHeader(next_block_size, is_next_allocated, 1)); // update header of next block with previous allocated bit
-
+void* calloc(size_t nmemb, size_t size)
+{
+    if (nmemb != 0 && size > SIZE_MAX / nmemb)
+        return NULL;
+    size *= nmemb;
+#ifdef MM_THREADS
+    //slots come from the thread cache, and mappings take no arena lock
+    if (size <= MAX_SLAB_SIZE || size > MMAP_THRESHOLD) {
+        void* ptr = tcache_malloc(size);
+        if (ptr != NULL && size <= MAX_SLAB_SIZE) {
+            memset(ptr, 0, size);
+        }
+        return ptr;
     }
-
+    lock_arena(get_thread_arena());
+    drain_remote_frees();
+    void* ptr = heap_calloc(size);
+    unlock_arena();
+    return ptr;
+#else
+    return heap_calloc(size);
+#endif
 }
 
 /**
- * @brief initialises the heap
+ * @brief allocates a block whose payload is aligned to alignment bytes
  * 
- * @return bool: true on success, false on error
+ * @param alignment: alignment of the payload, a power of two
+ * @param size: size of the block
+ * 
+ * @return void*: pointer to the allocated block, NULL if alignment is not a power of two or the heap cannot grow
  */
-bool mm_init(void)
+void* memalign(size_t alignment, size_t size)
 {
-    // IMPLEMENT THIS
-
-    //Create the initial empty heap
-    prologue_ptr = (uint64_t *)mem_sbrk(PADDING_SIZE + PROLOGUE_SIZE + EPILOGUE_SIZE);
-    
-    for (int i = 0; i < 14; i++) {
-        free_list[i].head = NULL;
-    }
-
-    if (prologue_ptr == (void *)-1)
-        return false;
-
-    write_block(prologue_ptr, 0); // Alignment padding
-    write_block(prologue_ptr + (PADDING_SIZE/UINT64_T_SIZE), packHeader(PROLOGUE_SIZE, 1, 0)); // Prologue header
-    write_block(prologue_ptr + ((PADDING_SIZE + HEADER_SIZE)/UINT64_T_SIZE), packFooter(PROLOGUE_SIZE, 1)); // Prologue footer
-    write_block(prologue_ptr + ((PADDING_SIZE + PROLOGUE_SIZE)/UINT64_T_SIZE), packHeader(0, 1, 1)); // Epilogue header
-
-    prologue_ptr += (PADDING_SIZE /UINT64_T_SIZE);
-
-    epilogue_ptr = prologue_ptr + (PROLOGUE_SIZE/UINT64_T_SIZE);
-
-    return true;
+#ifdef MM_THREADS
+    lock_arena(get_thread_arena());
+    drain_remote_frees();
+    void* ptr = heap_memalign(alignment, size);
+    unlock_arena();
+    return ptr;
+#else
+    return heap_memalign(alignment, size);
+#endif
 }
 
 /**
- * @brief malloc
+ * @brief aligned_alloc, which also accepts sizes that are not a multiple of alignment
  * 
+ * @param alignment: alignment of the payload, a power of two
  * @param size: size of the block
  * 
  * @return void*: pointer to the allocated block
  */
-void* malloc(size_t size)
+void* aligned_alloc(size_t alignment, size_t size)
 {
-    // IMPLEMENT THIS
-
-
-    if (size < 1)
-        return NULL;
+    return memalign(alignment, size);
+}
 
-    if (size < 16){
-        size = 16;
+/**
+ * @brief posix_memalign
+ * 
+ * @param memptr: receives the pointer to the allocated block, NULL if size is 0
+ * @param alignment: alignment of the payload, a power of two multiple of sizeof(void *)
+ * @param size: size of the block
+ * 
+ * @return int: 0 on success, EINVAL for a bad alignment, ENOMEM if the heap cannot grow
+ */
+int posix_memalign(void** memptr, size_t alignment, size_t size)
+{
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0 || alignment % sizeof(void *) != 0) {
+        return EINVAL;
     }
-
-    uint64_t current_block_size = (uint64_t)align(size + HEADER_SIZE);
-    uint64_t *free_block_ptr = find_first_fit(current_block_size);
-
-    if (free_block_ptr != NULL){
-        allocate_block(free_block_ptr, current_block_size);
-        return get_block_payload(free_block_ptr);
+    void* ptr = memalign(alignment, size);
+    if (ptr == NULL && size > 0) {
+        return ENOMEM;
     }
-
-    //if no free block of sufficient size is found, expand the heap
-    uint64_t *new_block_ptr = expand_heap(current_block_size);
-
-    if (new_block_ptr == NULL)
-        return NULL;
-
-    remove_free_block((free_list_node_t*)get_block_payload(new_block_ptr), get_list_index(get_block_size(new_block_ptr)));
-    allocate_block(new_block_ptr, current_block_size);
-    return get_block_payload(new_block_ptr);
-
+    *memptr = ptr;
+    return 0;
 }
 
 /**
- * @brief free
+ * @brief returns the number of bytes usable in a block, which may exceed the size it was requested with
  * 
- * @param ptr: pointer to the block to be freed
+ * @param ptr: pointer to the block
  * 
- * @return void
+ * @return size_t: usable size of the block, 0 if ptr is NULL
  */
-void free(void* ptr)
+size_t malloc_usable_size(void* ptr)
 {
-    // IMPLEMENT THIS
-
-    if (ptr == NULL)
-        return;
-
-    uint64_t* header_ptr = get_header(ptr);
-    uint64_t block_size = get_block_size(header_ptr);
-    free_list_node_t* free_block = (free_list_node_t*)ptr;
+    //the size of an allocated block or slot only changes through its owner, so no lock is needed
+    return heap_malloc_usable_size(ptr);
+}
 
-    if (get_next_block(header_ptr) == epilogue_ptr) {
-        write_block(epilogue_ptr, packHeader(0, 1, 0)); // update epilogue header with previous allocated bit
+/**
+ * @brief returns the usable size malloc gives a request of size bytes
+ * Requests of up to MAX_SLAB_SIZE bytes take a slot of their slab class, or an aligned block less its header while 
+ * their size takes no slab slots yet, and get the larger of both at most. Requests above MMAP_THRESHOLD take 
+ * their mapping less the padding and header, and the others the aligned block less its header.
+ * 
+ * @param size: size of the request
+ * 
+ * @return size_t: usable size of the block malloc returns, at least size
+ */
+size_t good_size(size_t size)
+{
+    if (size <= MAX_SLAB_SIZE) {
+        size_t slot_size = align(size < 16 ? 16 : size);
+        size_t block_usable_size = align((size < 16 ? 16 : size) + HEADER_SIZE) - HEADER_SIZE;
+        return slot_size > block_usable_size ? slot_size : block_usable_size;
     }
-    
-    write_block(get_footer(header_ptr), packFooter(block_size, 0)); // new free block footer
-    write_block(header_ptr, packHeader(block_size, 0, get_is_prev_allocated(header_ptr))); // new free block header
-
-    uint64_t* next_block_ptr = get_next_block(header_ptr);
-    uint64_t next_block_size = get_block_size(next_block_ptr);
-    uint64_t is_next_allocated = get_is_allocated(next_block_ptr);
-
-    write_block(next_block_ptr, packHeader(next_block_size, is_next_allocated, 0));
-
-    insert_free_block(free_block, get_list_index(block_size));
-    write_block(ptr,*((uint64_t *) free_block)); // set the payload to the free list node
-    
-    //coalesce if possible
-    coalesce(header_ptr);
-
-    return;
-
+    if (size > MMAP_THRESHOLD) {
+        uint64_t page_size = (uint64_t)mm_pagesize();
+        return ((size + PADDING_SIZE + HEADER_SIZE + page_size - 1) & ~(page_size - 1)) - PADDING_SIZE - HEADER_SIZE;
+    }
+    return align(size + HEADER_SIZE) - HEADER_SIZE;
 }
 
 /**
- * @brief realloc
+ * @brief grows a block in place only, to a usable size of up to max_size bytes and at least min_size bytes
  * 
- * @param oldptr: pointer to the old block
- * @param size: size of the new block
+ * @param ptr: pointer to the block
+ * @param min_size: smallest usable size the block has to reach
+ * @param max_size: usable size wanted for the block
  * 
- * @return void*: pointer to the new block
+ * @return size_t: usable size of the block, less than min_size if it could not grow enough and is unchanged
  */
-void* realloc(void* oldptr, size_t size)
+size_t try_expand(void* ptr, size_t min_size, size_t max_size)
 {
-    // IMPLEMENT THIS
-
-    if(oldptr == NULL){
-        return malloc(size);
+#ifdef MM_THREADS
+    if (ptr == NULL) {
+        return 0;
     }
-
-    if(size == 0){
-        free(oldptr);
-        return NULL;
+    //a mapped block is remapped under the mapping lock only
+    if (get_slab_page(ptr) == NULL && is_mapped_block(get_header(ptr))) {
+        return heap_try_expand(ptr, min_size, max_size);
     }
+    lock_arena(get_block_arena(ptr));
+    size_t usable_size = heap_try_expand(ptr, min_size, max_size);
+    unlock_arena();
+    return usable_size;
+#else
+    return heap_try_expand(ptr, min_size, max_size);
+#endif
+}
 
-    uint64_t* old_block_ptr = get_header(oldptr);
-    uint64_t old_block_size = get_block_size(old_block_ptr);
+/**
+ * @brief allocates n blocks of size bytes at once
+ * 
+ * @param size: size of each block
+ * @param n: number of blocks
+ * @param out: array receiving the pointers to the blocks
+ * 
+ * @return size_t: number of blocks allocated, less than n if the heap cannot grow
+ */
+size_t malloc_batch(size_t size, size_t n, void** out)
+{
+#ifdef MM_THREADS
+    lock_arena(get_thread_arena());
+    drain_remote_frees();
+    size_t count = heap_malloc_batch(size, n, out);
+    unlock_arena();
+    return count;
+#else
+    return heap_malloc_batch(size, n, out);
+#endif
+}
 
-    //align the size
-    if (size < 16){
-        size = 16;
+/**
+ * @brief frees n blocks at once, coalescing runs of adjacent blocks together
+ * 
+ * @param ptrs: pointers to the blocks, reordered, NULL entries are skipped
+ * @param n: number of pointers
+ * 
+ * @return void
+ */
+void free_batch(void** ptrs, size_t n)
+{
+#ifdef MM_THREADS
+    //mapped blocks belong to no arena
+    for (size_t i = 0; i < n; i++) {
+        if (ptrs[i] != NULL && get_slab_page(ptrs[i]) == NULL && is_mapped_block(get_header(ptrs[i]))) {
+            unmap_block(get_header(ptrs[i]));
+            ptrs[i] = NULL;
+        }
     }
 
-    uint64_t new_block_size = (uint64_t)align(size + HEADER_SIZE);
-
-    //if the new size is same as the old size, return the old pointer
-    if(old_block_size == new_block_size){
-        return oldptr;
-    }
-    //if the new size is less than the old size, allocate the block and return the old pointer
-    else if(old_block_size > new_block_size){
-        allocate_block(old_block_ptr, new_block_size);
-        return oldptr;
+    //sorted by address, the blocks of each arena are consecutive, since each arena grows in its own region
+    sort_pointers(ptrs, n);
+    size_t i = 0;
+    while (i < n && ptrs[i] == NULL) {
+        i++;
     }
-    //if the new size is greater than the old size, allocate a new block and copy the old block to the new block
-    else{
-        uint64_t* new_block_ptr = malloc(size);
-        if(new_block_ptr == NULL){
-            return NULL;
+    while (i < n) {
+        heap_ctl_t* arena = get_block_arena(ptrs[i]);
+        size_t run_end = i + 1;
+        while (run_end < n && get_block_arena(ptrs[run_end]) == arena) {
+            run_end++;
         }
-        memcpy(new_block_ptr, oldptr, old_block_size - HEADER_SIZE);
-        free(oldptr);
-        return new_block_ptr;
+        lock_arena(arena);
+        heap_free_batch(ptrs + i, run_end - i);
+        unlock_arena();
+        i = run_end;
     }
-    
-    return NULL;
+#else
+    heap_free_batch(ptrs, n);
+#endif
 }
 
 /**
- * @brief calloc
- * This function is not tested by mdriver, and has been implemented for you.
+ * @brief returns the free list nodes the fit scans visited since mm_init, counted when built with MM_FIT_STATS
  * 
- * @param nmemb: number of elements
- * @param size: size of each element
+ * @return long: number of nodes, -1 if they are not counted
+ */
+long mm_fit_nodes(void)
+{
+#if defined(MM_FIT_STATS) && !defined(MM_THREADS)
+    return (long)heap_ctl->fit_node_count;
+#else
+    return -1;
+#endif
+}
+
+/**
+ * @brief returns the metadata accesses fed to the modeled cache since mm_init, counted when built with MM_CACHE_MODEL
  * 
- * @return void*: pointer to the allocated block
+ * @return long: number of accesses, -1 if they are not counted
  */
-void* calloc(size_t nmemb, size_t size)
+long mm_cache_accesses(void)
 {
-    void* ptr;
-    size *= nmemb;
-    ptr = malloc(size);
-    if (ptr) {
-        memset(ptr, 0, size);
-    }
-    return ptr;
+#if defined(MM_CACHE_MODEL) && !defined(MM_THREADS)
+    return (long)heap_ctl->cache_access_count;
+#else
+    return -1;
+#endif
+}
+
+/**
+ * @brief returns the metadata accesses that missed the modeled cache since mm_init, counted when built with MM_CACHE_MODEL
+ * 
+ * @return long: number of misses, -1 if they are not counted
+ */
+long mm_cache_misses(void)
+{
+#if defined(MM_CACHE_MODEL) && !defined(MM_THREADS)
+    return (long)heap_ctl->cache_miss_count;
+#else
+    return -1;
+#endif
 }
 
 /*
@@ -906,7 +4637,7 @@ void* calloc(size_t nmemb, size_t size)
  */
 static bool in_heap(const void* p)
 {
-    return p <= mm_heap_hi() && p >= mm_heap_lo();
+    return p < (void *)((char *)heap_ctl->epilogue_ptr + EPILOGUE_SIZE) && p >= (void *)heap_ctl;
 }
 
 /*
@@ -919,6 +4650,61 @@ static bool aligned(const void* p)
     return align(ip) == ip;
 }
 
+/*
+ * Checks the large block tree rooted at node, whose keys must lie strictly between
+ * the keys of lo and hi (NULL for no bound). Returns the number of nodes.
+ */
+static uint64_t check_tree(free_tree_node_t* node, free_tree_node_t* lo, free_tree_node_t* hi)
+{
+    if (node == NULL) {
+        return 0;
+    }
+
+    uint64_t* header_ptr = get_header((uint64_t *)node);
+
+    //check if the tree node is a free block inside the heap
+    if(!in_heap(header_ptr) || get_is_allocated(header_ptr) == 1){
+        dbg_printf("Error: Large block tree node at %p is not a free block in the heap\n", header_ptr);
+        return 0;
+    }
+    //check if the tree node belongs to the top class
+    if(get_list_index(get_block_size(header_ptr)) != LARGE_LIST_INDEX){
+        dbg_printf("Error: Large block tree node at %p is too small\n", header_ptr);
+    }
+    //check the ordering by (size, address)
+    if((lo != NULL && compare_tree_key(node, get_block_size(get_header((uint64_t *)lo)), lo) <= 0) ||
+       (hi != NULL && compare_tree_key(node, get_block_size(get_header((uint64_t *)hi)), hi) >= 0)){
+        dbg_printf("Error: Large block tree node at %p is out of order\n", header_ptr);
+    }
+
+    return 1 + check_tree(node->left, lo, node) + check_tree(node->right, node, hi);
+}
+
+/*
+ * Checks the slots of a slab page: every free slot lies in the handed out part of the page 
+ * on a slot boundary, and the free and used slots add up to the handed out slots.
+ */
+static void check_slab_page(slab_page_t* page)
+{
+    uint64_t free_slot_count = 0;
+    uint64_t bumped_slot_count = (page->bump_offset - SLAB_HEADER_SIZE) / page->slot_size;
+
+    for(slab_slot_t* slot = page->free_slot; slot != NULL; slot = slot->next){
+        uint64_t offset = (uint64_t)((char *)slot - (char *)page);
+        if(offset < SLAB_HEADER_SIZE || offset >= page->bump_offset || (offset - SLAB_HEADER_SIZE) % page->slot_size != 0){
+            dbg_printf("Error: Free slot at %p is not a slot of slab page %p\n", slot, page);
+            return;
+        }
+        if(++free_slot_count > bumped_slot_count){
+            break;
+        }
+    }
+
+    if(free_slot_count + page->used_count != bumped_slot_count){
+        dbg_printf("Error: Slot counts of slab page at %p do not add up\n", page);
+    }
+}
+
 /*
  * mm_checkheap
  * You call the function via mm_checkheap(__LINE__)
@@ -931,12 +4717,44 @@ bool mm_checkheap(int line_number)
     // Write code to check heap invariants here
     // IMPLEMENT THIS
 
-    uint64_t* current_block_ptr = prologue_ptr;
+    uint64_t* current_block_ptr = heap_ctl->prologue_ptr;
+    uint64_t large_free_block_count = 0;
+    uint64_t quick_block_count = 0;
+    uint64_t slab_page_count = 0;
+    uint64_t partial_slab_page_count = 0;
+    uint64_t mini_block_count = 0;
+    uint64_t* prev_block_ptr = NULL;
+
+    while(current_block_ptr != heap_ctl->epilogue_ptr){
+
+        if(get_is_quick(current_block_ptr) == 1){
+            quick_block_count++;
+            //check if a quick block is marked allocated
+            if(get_is_allocated(current_block_ptr) == 0){
+                dbg_printf("Error: Quick block at %p is not marked allocated\n", current_block_ptr);
+            }
+        }
+
+        if(get_is_allocated(current_block_ptr) == 0 && get_list_index(get_block_size(current_block_ptr)) == LARGE_LIST_INDEX && current_block_ptr != heap_ctl->wilderness){
+            large_free_block_count++;
+        }
 
-    while(current_block_ptr != epilogue_ptr){
+        //check if a free block at the end of the heap is the wilderness block
+        if(get_is_allocated(current_block_ptr) == 0 && get_next_block(current_block_ptr) == heap_ctl->epilogue_ptr && current_block_ptr != heap_ctl->wilderness){
+            dbg_printf("Error: Free block at %p ends the heap but is not the wilderness block\n", current_block_ptr);
+        }
 
         uint64_t current_block_size = get_block_size(current_block_ptr);
 
+        slab_page_t* page = (slab_page_t *)get_block_payload(current_block_ptr);
+        if(get_is_allocated(current_block_ptr) == 1 && current_block_size == SLAB_PAGE_SIZE && get_slab_page((char *)page + SLAB_HEADER_SIZE) == page){
+            slab_page_count++;
+            if(!is_slab_page_full(page)){
+                partial_slab_page_count++;
+            }
+            check_slab_page(page);
+        }
+
         //check if every block is 16-byte aligned
         if(current_block_size % 16 != 0){
             dbg_printf("Error: Block at %p is not 16-byte aligned\n", current_block_ptr);
@@ -947,18 +4765,46 @@ bool mm_checkheap(int line_number)
             dbg_printf("Error: Contiguous free blocks at %p and %p escaped coalescing\n", get_prev_block(current_block_ptr), current_block_ptr);
         }
 
-        //check if the header and footer of each free block match
+        //check if the previous mini bit of a block after a free block tells if the free block is a mini block
+        if(prev_block_ptr != NULL && get_is_allocated(prev_block_ptr) == 0 && 
+           ((read_block(current_block_ptr) & PREV_MINI_BIT) != 0) != (get_block_size(prev_block_ptr) == MINI_BLOCK_SIZE)){
+            dbg_printf("Error: Previous mini bit of block at %p does not match the free block before it\n", current_block_ptr);
+        }
+
+        if(get_is_allocated(current_block_ptr) == 0 && current_block_size == MINI_BLOCK_SIZE && current_block_ptr != heap_ctl->wilderness && 
+           get_mini_link((mini_list_node_t *)get_block_payload(current_block_ptr)) <= MAX_MINI_LINK){
+            mini_block_count++;
+        }
+
+        //check if the header and footer of each free block match, mini blocks have no footer
         //check for size bits
-        if(get_is_allocated(current_block_ptr) == 0 && get_block_size(current_block_ptr) != get_block_size(get_footer(current_block_ptr))){
+        if(get_is_allocated(current_block_ptr) == 0 && current_block_size != MINI_BLOCK_SIZE && get_block_size(current_block_ptr) != get_block_size(get_footer(current_block_ptr))){
             dbg_printf("Error: Header and footer of free block at %p do not match in size bits\n", current_block_ptr);
         }
         //check for allocated bits
-        if(get_is_allocated(current_block_ptr) == 0 && get_is_allocated(current_block_ptr) != get_is_allocated(get_footer(current_block_ptr))){
+        if(get_is_allocated(current_block_ptr) == 0 && current_block_size != MINI_BLOCK_SIZE && get_is_allocated(current_block_ptr) != get_is_allocated(get_footer(current_block_ptr))){
             dbg_printf("Error: Header and footer of free block at %p do not match in allocated bits\n", current_block_ptr);
         }
         
+        //check if only the large free blocks are marked purged
+        if(get_is_allocated(current_block_ptr) == 0 && current_block_size != MINI_BLOCK_SIZE && (read_block(get_footer(current_block_ptr)) & PURGED_BIT) && 
+           (get_list_index(current_block_size) != LARGE_LIST_INDEX || current_block_ptr == heap_ctl->wilderness)){
+            dbg_printf("Error: Free block at %p is marked purged but is not in the large block tree\n", current_block_ptr);
+        }
+
+        //check if the free blocks marked zero are zero past their free list node
+        if(get_is_allocated(current_block_ptr) == 0 && is_zero_block(current_block_ptr)){
+            uint32_t* zero_ptr = (uint32_t *)((char *)get_block_payload(current_block_ptr) + sizeof(free_tree_node_t));
+            for(; zero_ptr < (uint32_t *)get_footer(current_block_ptr); zero_ptr++){
+                if(*zero_ptr != 0){
+                    dbg_printf("Error: Free block at %p is marked zero but reads %x at %p\n", current_block_ptr, *zero_ptr, zero_ptr);
+                    break;
+                }
+            }
+        }
+
         //check if any block exceed heap size
-        if(get_block_size(current_block_ptr) > mem_heapsize()){
+        if(get_block_size(current_block_ptr) > get_heap_size()){
             dbg_printf("Error: Block at %p exceeds heap size\n", current_block_ptr);
         }
 
@@ -967,12 +4813,22 @@ bool mm_checkheap(int line_number)
             dbg_printf("Error: Block at %p is outside the heap\n", current_block_ptr);
         }
 
+        prev_block_ptr = current_block_ptr;
         current_block_ptr = get_next_block(current_block_ptr);
 
 
     }
 
-    for(int i = 0; i<14 ;i++){
+    free_list_t* free_list = heap_ctl->free_list;
+
+    for(int i = 0; i < FREE_LIST_COUNT; i++){
+
+        //check if the bitmaps match the non-empty free lists
+        uint64_t is_sl_bit_set = (heap_ctl->sl_bitmap[i / SL_INDEX_COUNT] >> (i % SL_INDEX_COUNT)) & 0x1;
+        uint64_t is_fl_bit_set = (heap_ctl->fl_bitmap >> (i / SL_INDEX_COUNT)) & 0x1;
+        if(is_sl_bit_set != (free_list[i].head != NULL) || (is_sl_bit_set == 1 && is_fl_bit_set == 0)){
+            dbg_printf("Error: Bitmaps do not match free list %d\n", i);
+        }
 
         if (free_list[i].head != NULL){
             free_list_node_t *current_block_ptr = free_list[i].head;
@@ -983,33 +4839,33 @@ bool mm_checkheap(int line_number)
                 }
 
                 //check if the next block pointer in consistent
-                if(current_block_ptr->next != NULL){
+                if(get_next_node(current_block_ptr) != NULL){
                     //check if the next is pointing inside the heap
-                    if(!in_heap(get_header((uint64_t *)current_block_ptr->next))){
+                    if(!in_heap(get_header((uint64_t *)get_next_node(current_block_ptr)))){
                         dbg_printf("Error: Next pointer of block at %p is outside the heap\n", get_header((uint64_t *)current_block_ptr));
                     }
                     //check if the next block is pointing to a free block
-                    if(get_is_allocated(get_header((uint64_t *)current_block_ptr->next)) == 1){
+                    if(get_is_allocated(get_header((uint64_t *)get_next_node(current_block_ptr))) == 1){
                         dbg_printf("Error: Next pointer of block at %p is pointing to an allocated block\n", get_header((uint64_t *)current_block_ptr));
                     }
                     //check if the next block is pointing to a block in the same free list
-                    if(get_list_index(get_block_size(get_header((uint64_t *)current_block_ptr->next))) != i){
+                    if(get_list_index(get_block_size(get_header((uint64_t *)get_next_node(current_block_ptr)))) != i){
                         dbg_printf("Error: Next pointer of block at %p is pointing to a block in a different free list\n", get_header((uint64_t *)current_block_ptr));
                     }
                 }
 
                 //check if the prev block pointer in consistent
-                if(current_block_ptr->prev != NULL){
+                if(get_prev_node(current_block_ptr) != NULL){
                     //check if the prev is pointing inside the heap
-                    if(!in_heap(get_header((uint64_t *)current_block_ptr->prev))){
+                    if(!in_heap(get_header((uint64_t *)get_prev_node(current_block_ptr)))){
                         dbg_printf("Error: Prev pointer of block at %p is outside the heap\n", get_header((uint64_t *)current_block_ptr));
                     }
                     //check if the prev block is pointing to a free block
-                    if(get_is_allocated(get_header((uint64_t *)current_block_ptr->prev)) == 1){
+                    if(get_is_allocated(get_header((uint64_t *)get_prev_node(current_block_ptr))) == 1){
                         dbg_printf("Error: Prev pointer of block at %p is pointing to an allocated block\n", get_header((uint64_t *)current_block_ptr));
                     }
                     //check if the prev block is pointing to a block in the same free list
-                    if(get_list_index(get_block_size(get_header((uint64_t *)current_block_ptr->prev))) != i){
+                    if(get_list_index(get_block_size(get_header((uint64_t *)get_prev_node(current_block_ptr)))) != i){
                         dbg_printf("Error: Prev pointer of block at %p is pointing to a block in a different free list\n", get_header((uint64_t *)current_block_ptr));
                     }
                 }
@@ -1019,7 +4875,12 @@ bool mm_checkheap(int line_number)
                     dbg_printf("Error: Free block at %p is in wrong free list\n", get_header((uint64_t *)current_block_ptr));
                 }
 
-                current_block_ptr = current_block_ptr->next;
+                //check if the free block is within the size bound of the list
+                if(get_block_size(get_header((uint64_t *)current_block_ptr)) / ALIGNMENT > heap_ctl->list_max[i]){
+                    dbg_printf("Error: Free block at %p exceeds the size bound of free list %d\n", get_header((uint64_t *)current_block_ptr), i);
+                }
+
+                current_block_ptr = get_next_node(current_block_ptr);
                 
             } while(current_block_ptr != free_list[i].head);
             
@@ -1027,6 +4888,105 @@ bool mm_checkheap(int line_number)
         }
     }
 
+    //check if the wilderness block is a free block ending the heap
+    if(heap_ctl->wilderness != NULL && (get_is_allocated(heap_ctl->wilderness) == 1 || get_next_block(heap_ctl->wilderness) != heap_ctl->epilogue_ptr)){
+        dbg_printf("Error: Wilderness block at %p is not a free block ending the heap\n", heap_ctl->wilderness);
+    }
+
+    //check if every block of the quick lists is a quick block of the right size, and every quick block is in a quick list
+    uint64_t quick_bytes = 0;
+    for(int i = 0; i < QUICK_LIST_COUNT; i++){
+        for(quick_list_node_t* quick_block = heap_ctl->quick_list[i]; quick_block != NULL; quick_block = quick_block->next){
+            uint64_t* header_ptr = get_header((uint64_t *)quick_block);
+            if(!in_heap(header_ptr) || get_is_quick(header_ptr) == 0){
+                dbg_printf("Error: Block at %p in quick list %d is not a quick block\n", header_ptr, i);
+                break;
+            }
+            if(get_block_size(header_ptr) != (uint64_t)(i + QUICK_LIST_OFFSET) * ALIGNMENT){
+                dbg_printf("Error: Quick block at %p is in the wrong quick list\n", header_ptr);
+            }
+            quick_bytes += get_block_size(header_ptr);
+            quick_block_count--;
+        }
+    }
+    if(quick_block_count != 0 || quick_bytes != heap_ctl->quick_bytes){
+        dbg_printf("Error: Quick lists do not hold exactly the quick blocks\n");
+    }
+
+    //check if the mini list holds exactly the free mini blocks
+    mini_list_node_t* prev_mini_block = NULL;
+    for(mini_list_node_t* mini_block = heap_ctl->mini_list; mini_block != NULL; mini_block = get_mini_node(mini_block->next)){
+        uint64_t* header_ptr = get_header((uint64_t *)mini_block);
+        if(!in_heap(header_ptr) || get_is_allocated(header_ptr) == 1 || get_block_size(header_ptr) != MINI_BLOCK_SIZE){
+            dbg_printf("Error: Block at %p in the mini list is not a free mini block\n", header_ptr);
+            break;
+        }
+        if(get_mini_node(mini_block->prev) != prev_mini_block){
+            dbg_printf("Error: Previous link of the mini block at %p does not point to the block before it\n", header_ptr);
+        }
+        prev_mini_block = mini_block;
+        mini_block_count--;
+    }
+    if(mini_block_count != 0){
+        dbg_printf("Error: Mini list does not hold exactly the free mini blocks\n");
+    }
+
+    //check if the partial page lists hold exactly the non-full slab pages
+    for(int i = 0; i < SLAB_CLASS_COUNT; i++){
+        for(slab_page_t* page = heap_ctl->slab_partial[i]; page != NULL; page = page->next){
+            if(get_slab_page((char *)page + SLAB_HEADER_SIZE) != page || page->slot_size != (uint64_t)(i + 1) * ALIGNMENT || is_slab_page_full(page)){
+                dbg_printf("Error: Page at %p in slab class %d is not a partial slab page of the class\n", page, i);
+                break;
+            }
+            if(page->next != NULL && page->next->prev != page){
+                dbg_printf("Error: Prev pointer of slab page at %p is inconsistent\n", page->next);
+            }
+            partial_slab_page_count--;
+        }
+    }
+    if(partial_slab_page_count != 0 || slab_page_count != heap_ctl->slab_page_count){
+        dbg_printf("Error: Slab page lists do not hold exactly the partial slab pages\n");
+    }
+
+    //check if the slab page map marks no page besides the slab pages found above
+    uint64_t slab_map_count = 0;
+    if(heap_ctl->slab_map != NULL){
+        for(uint64_t i = 0; i < heap_ctl->slab_map[0] / 64; i++){
+            slab_map_count += (uint64_t)__builtin_popcountll(heap_ctl->slab_map[1 + i]);
+        }
+    }
+    if(slab_map_count != slab_page_count){
+        dbg_printf("Error: Slab page map does not mark exactly the slab pages\n");
+    }
+
+    //check if every large free block is in the large block tree
+    if(check_tree(heap_ctl->large_tree, NULL, NULL) != large_free_block_count){
+        dbg_printf("Error: Large block tree does not hold every large free block\n");
+    }
+
+    //check if the dirty block list holds only unpurged blocks of the large block tree
+    uint64_t dirty_block_count = 0;
+    free_tree_node_t* dirty_block = heap_ctl->dirty_blocks;
+    while(dirty_block != NULL && dirty_block_count <= large_free_block_count){
+        uint64_t* header_ptr = get_header((uint64_t *)dirty_block);
+        if(!in_heap(header_ptr) || get_is_allocated(header_ptr) == 1 || get_list_index(get_block_size(header_ptr)) != LARGE_LIST_INDEX || 
+           header_ptr == heap_ctl->wilderness || (read_block(get_footer(header_ptr)) & PURGED_BIT)){
+            dbg_printf("Error: Dirty block list node at %p is not an unpurged block of the large block tree\n", header_ptr);
+            break;
+        }
+        if(dirty_block->next_dirty->prev_dirty != dirty_block){
+            dbg_printf("Error: Prev pointer of dirty block at %p is inconsistent\n", dirty_block->next_dirty);
+        }
+        dirty_block_count++;
+        dirty_block = dirty_block->next_dirty;
+        if(dirty_block == heap_ctl->dirty_blocks){
+            break;
+        }
+    }
+    if(dirty_block_count > large_free_block_count){
+        dbg_printf("Error: Dirty block list holds more blocks than the large block tree\n");
+    }
+
 #endif // DEBUG
     return true;
 }
@@ -8,6 +8,15 @@ extern void* mm_malloc (size_t size);
 extern void mm_free (void* ptr);
 extern void* mm_realloc(void* ptr, size_t size);
 extern void* mm_calloc (size_t nmemb, size_t size);
+extern size_t mm_malloc_batch (size_t size, size_t n, void** out);
+extern void mm_free_batch (void** ptrs, size_t n);
+extern void mm_free_sized (void* ptr, size_t size);
+extern void* mm_memalign (size_t alignment, size_t size);
+extern void* mm_aligned_alloc (size_t alignment, size_t size);
+extern int mm_posix_memalign (void** memptr, size_t alignment, size_t size);
+extern size_t mm_malloc_usable_size (void* ptr);
+extern size_t mm_good_size (size_t size);
+extern size_t mm_try_expand (void* ptr, size_t min_size, size_t max_size);
 
 #else
 
@@ -16,10 +25,31 @@ extern void* malloc (size_t size);
 extern void free (void* ptr);
 extern void* realloc(void* ptr, size_t size);
 extern void* calloc (size_t nmemb, size_t size);
+extern size_t malloc_batch (size_t size, size_t n, void** out);
+extern void free_batch (void** ptrs, size_t n);
+extern void free_sized (void* ptr, size_t size);
+extern void* memalign (size_t alignment, size_t size);
+extern void* aligned_alloc (size_t alignment, size_t size);
+extern int posix_memalign (void** memptr, size_t alignment, size_t size);
+extern size_t malloc_usable_size (void* ptr);
+extern size_t good_size (size_t size);
+extern size_t try_expand (void* ptr, size_t min_size, size_t max_size);
 
 #endif
 
 extern bool mm_init(void);
 
+#ifdef MM_THREADS
+/* Frees the blocks queued by MM_ASYNC_FREE and stops the maintenance thread */
+extern void mm_quiesce(void);
+#endif
+
 /* This is for debugging.  Returns false if error encountered */
 extern bool mm_checkheap(int line_number);
+
+/* Free list nodes the fit scans visited since mm_init, -1 unless built with -DMM_FIT_STATS */
+extern long mm_fit_nodes(void);
+
+/* Metadata accesses fed to the modeled data cache since mm_init, and those that missed it, -1 unless built with -DMM_CACHE_MODEL */
+extern long mm_cache_accesses(void);
+extern long mm_cache_misses(void);
@@ -0,0 +1,522 @@
+/*
+ * mtbench.c - Multi-threaded scaling benchmark for the -DMM_THREADS build of mm.c
+ *
+ * Runs the same malloc/free workload on 1, 2, 4, ... up to N threads and
+ * reports the total throughput and the speedup over one thread. Each thread
+ * keeps a working set of blocks and, at random, frees a live block or
+ * allocates a new one, mostly small (1 to 256 bytes) with a tail of larger
+ * blocks (up to 4 KiB).
+ *
+ * With -p, runs 1, 2, 4, ... up to N/2 producer/consumer pairs instead: the
+ * producer allocates blocks and hands them over a ring to the consumer,
+ * which frees them, so every free is a cross-thread free. Each run is done
+ * with the remote free queues of the arenas (MM_REMOTE_FREE=1) and without
+ * them (MM_REMOTE_FREE=0, remote frees lock the owning arena).
+ *
+ * With -l, each thread repeatedly builds a graph of GRAPH_SIZE blocks and
+ * frees it, timing every free, and the free latency percentiles are
+ * reported with synchronous frees (MM_ASYNC_FREE=0) and with frees queued
+ * for the maintenance thread (MM_ASYNC_FREE=1).
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mm.h"
+#include "memlib.h"
+
+/* Workload */
+#define WORKING_SET     512       /* live block slots per thread */
+#define LARGE_PERCENT   10        /* share of requests above 256 bytes */
+#define MAX_THREADS     64
+#define RING_SIZE       1024      /* blocks in flight between a producer and its consumer */
+#define GRAPH_SIZE      4096      /* blocks built then freed at once in latency mode */
+
+/* Single producer, single consumer ring of blocks */
+typedef struct {
+    unsigned char *slots[RING_SIZE];
+    unsigned long head;           /* next slot to fill, written by the producer */
+    unsigned long tail;           /* next slot to drain, written by the consumer */
+} ring_t;
+
+typedef struct {
+    int id;
+    long ops;
+    pthread_barrier_t *barrier;
+    ring_t *ring;                 /* producer/consumer mode only */
+    uint64_t *latencies;          /* latency mode only, ops free latencies in ns */
+    struct timespec start;        /* when the thread passed the barrier */
+} worker_t;
+
+static void usage(char *prog);
+
+/*
+ * next_rand - xorshift64 step, private to each thread
+ */
+static uint64_t next_rand(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+/*
+ * run_worker - one thread of the workload
+ */
+static void *run_worker(void *arg)
+{
+    worker_t *worker = (worker_t *) arg;
+    uint64_t state = 0x9E3779B97F4A7C15ULL * (uint64_t)(worker->id + 1);
+    unsigned char *slots[WORKING_SET];
+    long i;
+
+    memset(slots, 0, sizeof(slots));
+    pthread_barrier_wait(worker->barrier);
+    clock_gettime(CLOCK_MONOTONIC, &worker->start);
+
+    for (i = 0; i < worker->ops; i++) {
+        uint64_t r = next_rand(&state);
+        int slot = (int)(r % WORKING_SET);
+
+        if (slots[slot] != NULL) {
+            if (slots[slot][0] != (unsigned char) slot) {
+                fprintf(stderr, "mtbench: block of thread %d was overwritten\n", worker->id);
+                exit(1);
+            }
+            mm_free(slots[slot]);
+            slots[slot] = NULL;
+        } else {
+            size_t size = (r >> 32) % 100 < LARGE_PERCENT ?
+                257 + (r >> 40) % 3840 : 1 + (r >> 40) % 256;
+            slots[slot] = mm_malloc(size);
+            if (slots[slot] == NULL) {
+                fprintf(stderr, "mtbench: out of memory\n");
+                exit(1);
+            }
+            slots[slot][0] = (unsigned char) slot;
+        }
+    }
+
+    for (i = 0; i < WORKING_SET; i++) {
+        mm_free(slots[i]);
+    }
+    return NULL;
+}
+
+/*
+ * run_producer - allocates ops blocks and passes them to the consumer
+ */
+static void *run_producer(void *arg)
+{
+    worker_t *worker = (worker_t *) arg;
+    ring_t *ring = worker->ring;
+    uint64_t state = 0x9E3779B97F4A7C15ULL * (uint64_t)(worker->id + 1);
+    long i;
+
+    pthread_barrier_wait(worker->barrier);
+    clock_gettime(CLOCK_MONOTONIC, &worker->start);
+
+    for (i = 0; i < worker->ops; i++) {
+        uint64_t r = next_rand(&state);
+        size_t size = (r >> 32) % 100 < LARGE_PERCENT ?
+            257 + (r >> 40) % 3840 : 1 + (r >> 40) % 256;
+        unsigned char *block = mm_malloc(size);
+        if (block == NULL) {
+            fprintf(stderr, "mtbench: out of memory\n");
+            exit(1);
+        }
+        block[0] = (unsigned char) i;
+
+        while (ring->head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == RING_SIZE) {
+            sched_yield();
+        }
+        ring->slots[ring->head % RING_SIZE] = block;
+        __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+/*
+ * run_consumer - frees the ops blocks of the producer
+ */
+static void *run_consumer(void *arg)
+{
+    worker_t *worker = (worker_t *) arg;
+    ring_t *ring = worker->ring;
+    long i;
+
+    pthread_barrier_wait(worker->barrier);
+    clock_gettime(CLOCK_MONOTONIC, &worker->start);
+
+    for (i = 0; i < worker->ops; i++) {
+        while (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == ring->tail) {
+            sched_yield();
+        }
+        unsigned char *block = ring->slots[ring->tail % RING_SIZE];
+        if (block[0] != (unsigned char) i) {
+            fprintf(stderr, "mtbench: block of producer %d was overwritten\n", worker->id);
+            exit(1);
+        }
+        mm_free(block);
+        __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+/*
+ * now_ns - monotonic clock in nanoseconds
+ */
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+/*
+ * run_graphs - builds and frees graphs of blocks until ops frees are timed
+ */
+static void *run_graphs(void *arg)
+{
+    worker_t *worker = (worker_t *) arg;
+    uint64_t state = 0x9E3779B97F4A7C15ULL * (uint64_t)(worker->id + 1);
+    unsigned char *nodes[GRAPH_SIZE];
+    long done = 0;
+    int i;
+
+    pthread_barrier_wait(worker->barrier);
+    clock_gettime(CLOCK_MONOTONIC, &worker->start);
+
+    while (done < worker->ops) {
+        for (i = 0; i < GRAPH_SIZE; i++) {
+            uint64_t r = next_rand(&state);
+            size_t size = (r >> 32) % 100 < 50 ?
+                257 + (r >> 40) % 3840 : 1 + (r >> 40) % 256;
+            nodes[i] = mm_malloc(size);
+            if (nodes[i] == NULL) {
+                fprintf(stderr, "mtbench: out of memory\n");
+                exit(1);
+            }
+            nodes[i][0] = (unsigned char) i;
+        }
+        for (i = 0; i < GRAPH_SIZE; i++) {
+            if (nodes[i][0] != (unsigned char) i) {
+                fprintf(stderr, "mtbench: block of thread %d was overwritten\n", worker->id);
+                exit(1);
+            }
+            uint64_t start = now_ns();
+            mm_free(nodes[i]);
+            uint64_t end = now_ns();
+            if (done < worker->ops) {
+                worker->latencies[done++] = end - start;
+            }
+        }
+    }
+    return NULL;
+}
+
+/*
+ * elapsed_secs - seconds from the first worker passing the barrier to end
+ *
+ * The main thread may only run again after the workers are done when there
+ * are more threads than CPUs, so the workers stamp their own start.
+ */
+static double elapsed_secs(worker_t *workers, int nworkers, struct timespec *end)
+{
+    struct timespec start = workers[0].start;
+    int i;
+
+    for (i = 1; i < nworkers; i++) {
+        if (workers[i].start.tv_sec < start.tv_sec ||
+            (workers[i].start.tv_sec == start.tv_sec && workers[i].start.tv_nsec < start.tv_nsec)) {
+            start = workers[i].start;
+        }
+    }
+    return (end->tv_sec - start.tv_sec) + (end->tv_nsec - start.tv_nsec) / 1e9;
+}
+
+/*
+ * run_threads - runs the workload on nthreads threads, returns the elapsed seconds
+ */
+static double run_threads(int nthreads, long ops)
+{
+    pthread_t threads[MAX_THREADS];
+    worker_t workers[MAX_THREADS];
+    pthread_barrier_t barrier;
+    struct timespec end;
+    int i;
+
+    if (!mm_init()) {
+        fprintf(stderr, "mtbench: mm_init failed\n");
+        exit(1);
+    }
+
+    pthread_barrier_init(&barrier, NULL, nthreads + 1);
+    for (i = 0; i < nthreads; i++) {
+        workers[i].id = i;
+        workers[i].ops = ops;
+        workers[i].barrier = &barrier;
+        pthread_create(&threads[i], NULL, run_worker, &workers[i]);
+    }
+
+    pthread_barrier_wait(&barrier);
+    for (i = 0; i < nthreads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    pthread_barrier_destroy(&barrier);
+
+    mem_reset_brk();
+    return elapsed_secs(workers, nthreads, &end);
+}
+
+/*
+ * run_pairs - runs npairs producer/consumer pairs, with or without the
+ *             remote free queues, returns the elapsed seconds
+ */
+static double run_pairs(int npairs, long ops, int remote_free)
+{
+    pthread_t threads[MAX_THREADS];
+    worker_t workers[MAX_THREADS];
+    ring_t *rings;
+    pthread_barrier_t barrier;
+    struct timespec end;
+    int i;
+
+    setenv("MM_REMOTE_FREE", remote_free ? "1" : "0", 1);
+    if (!mm_init()) {
+        fprintf(stderr, "mtbench: mm_init failed\n");
+        exit(1);
+    }
+
+    rings = calloc(npairs, sizeof(ring_t));
+    if (rings == NULL) {
+        fprintf(stderr, "mtbench: out of memory\n");
+        exit(1);
+    }
+
+    pthread_barrier_init(&barrier, NULL, 2 * npairs + 1);
+    for (i = 0; i < 2 * npairs; i++) {
+        workers[i].id = i / 2;
+        workers[i].ops = ops;
+        workers[i].barrier = &barrier;
+        workers[i].ring = &rings[i / 2];
+        pthread_create(&threads[i], NULL, i % 2 == 0 ? run_producer : run_consumer, &workers[i]);
+    }
+
+    pthread_barrier_wait(&barrier);
+    for (i = 0; i < 2 * npairs; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    pthread_barrier_destroy(&barrier);
+    free(rings);
+
+    mem_reset_brk();
+    return elapsed_secs(workers, 2 * npairs, &end);
+}
+
+/*
+ * compare_latency - qsort order of latencies
+ */
+static int compare_latency(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * run_latency - builds and frees graphs on nthreads threads, with synchronous
+ *               or asynchronous frees, and sorts the free latencies into
+ *               latencies (nthreads * ops entries), returns the elapsed seconds
+ */
+static double run_latency(int nthreads, long ops, int async_free, uint64_t *latencies)
+{
+    pthread_t threads[MAX_THREADS];
+    worker_t workers[MAX_THREADS];
+    pthread_barrier_t barrier;
+    struct timespec end;
+    int i;
+
+    setenv("MM_ASYNC_FREE", async_free ? "1" : "0", 1);
+    if (!mm_init()) {
+        fprintf(stderr, "mtbench: mm_init failed\n");
+        exit(1);
+    }
+
+    pthread_barrier_init(&barrier, NULL, nthreads + 1);
+    for (i = 0; i < nthreads; i++) {
+        workers[i].id = i;
+        workers[i].ops = ops;
+        workers[i].barrier = &barrier;
+        workers[i].latencies = latencies + i * ops;
+        pthread_create(&threads[i], NULL, run_graphs, &workers[i]);
+    }
+
+    pthread_barrier_wait(&barrier);
+    for (i = 0; i < nthreads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    mm_quiesce();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    pthread_barrier_destroy(&barrier);
+
+    qsort(latencies, nthreads * ops, sizeof(uint64_t), compare_latency);
+
+    mem_reset_brk();
+    return elapsed_secs(workers, nthreads, &end);
+}
+
+/*
+ * scale_threads - reports the scaling of the random workload
+ */
+static void scale_threads(int max_threads, long ops)
+{
+    double base = 0;
+    int nthreads;
+
+    printf("%8s %12s %12s %8s\n", "threads", "ops", "Mops/sec", "speedup");
+    for (nthreads = 1; ; nthreads *= 2) {
+        if (nthreads > max_threads) {
+            nthreads = max_threads;
+        }
+        double secs = run_threads(nthreads, ops);
+        double mops = nthreads * ops / secs / 1e6;
+        if (nthreads == 1) {
+            base = mops;
+        }
+        printf("%8d %12ld %12.1f %7.2fx\n", nthreads, nthreads * ops, mops, mops / base);
+        if (nthreads == max_threads) {
+            break;
+        }
+    }
+}
+
+/*
+ * scale_pairs - reports the producer/consumer throughput with and without
+ *               the remote free queues
+ */
+static void scale_pairs(int max_pairs, long ops)
+{
+    int npairs;
+
+    printf("%8s %12s %16s %16s %8s\n", "pairs", "blocks", "queue Mops/sec", "locked Mops/sec", "gain");
+    for (npairs = 1; ; npairs *= 2) {
+        if (npairs > max_pairs) {
+            npairs = max_pairs;
+        }
+        double queue_mops = npairs * ops / run_pairs(npairs, ops, 1) / 1e6;
+        double locked_mops = npairs * ops / run_pairs(npairs, ops, 0) / 1e6;
+        printf("%8d %12ld %16.1f %16.1f %7.2fx\n", npairs, npairs * ops, queue_mops, locked_mops, queue_mops / locked_mops);
+        if (npairs == max_pairs) {
+            break;
+        }
+    }
+}
+
+/*
+ * scale_latency - reports the free latency percentiles with synchronous
+ *                 and asynchronous frees
+ */
+static void scale_latency(int max_threads, long ops)
+{
+    uint64_t *latencies = malloc(max_threads * ops * sizeof(uint64_t));
+    int nthreads;
+    int async_free;
+
+    if (latencies == NULL) {
+        fprintf(stderr, "mtbench: out of memory\n");
+        exit(1);
+    }
+
+    printf("%8s %6s %12s %10s %10s %10s %10s\n", "threads", "free", "frees", "p50 ns", "p99 ns", "p99.9 ns", "Mops/sec");
+    for (nthreads = 1; ; nthreads *= 2) {
+        if (nthreads > max_threads) {
+            nthreads = max_threads;
+        }
+        for (async_free = 0; async_free <= 1; async_free++) {
+            long total = nthreads * ops;
+            double secs = run_latency(nthreads, ops, async_free, latencies);
+            printf("%8d %6s %12ld %10lu %10lu %10lu %10.1f\n", nthreads, async_free ? "async" : "sync", total,
+                   (unsigned long) latencies[total / 2], (unsigned long) latencies[total * 99 / 100],
+                   (unsigned long) latencies[total * 999 / 1000], 2 * total / secs / 1e6);
+        }
+        if (nthreads == max_threads) {
+            break;
+        }
+    }
+
+    free(latencies);
+}
+
+int main(int argc, char **argv)
+{
+    int max_threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    long ops = 2000000;
+    int pairs = 0;
+    int latency = 0;
+    int c;
+
+    while ((c = getopt(argc, argv, "t:n:plh")) != EOF) {
+        switch (c) {
+        case 'p':
+            pairs = 1;
+            break;
+        case 'l':
+            latency = 1;
+            break;
+        case 't':
+            max_threads = atoi(optarg);
+            break;
+        case 'n':
+            ops = atol(optarg);
+            break;
+        case 'h':
+            usage(argv[0]);
+            exit(0);
+        default:
+            usage(argv[0]);
+            exit(1);
+        }
+    }
+    if (max_threads < 1 || max_threads > MAX_THREADS || ops < 1) {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    mem_init();
+
+    if (pairs) {
+        scale_pairs(max_threads < 2 ? 1 : max_threads / 2, ops);
+    } else if (latency) {
+        scale_latency(max_threads, ops);
+    } else {
+        scale_threads(max_threads, ops);
+    }
+
+    mem_deinit();
+    return 0;
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(char *prog)
+{
+    fprintf(stderr, "Usage: %s [-p | -l] [-t <max threads>] [-n <ops per thread>]\n", prog);
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-p        Run producer/consumer pairs, with and without remote free queues.\n");
+    fprintf(stderr, "\t-l        Time the frees of graphs of blocks, synchronous and asynchronous.\n");
+    fprintf(stderr, "\t-t <n>    Scale from 1 up to <n> threads (default: online CPUs, at most %d).\n", MAX_THREADS);
+    fprintf(stderr, "\t-n <n>    Run <n> operations on each thread, blocks per pair with -p, frees with -l (default: 2000000).\n");
+    fprintf(stderr, "\t-h        Print this message.\n");
+}